@@ -0,0 +1,196 @@
+// gui_frame_bench.cpp - headless frame-cost benchmark for the chat log view
+//
+// Drives ChatLog + ChatLogView through the same window layout as ChatGui::render_chat_window,
+// using the ImGui null platform/renderer backends, so it runs on a CI box without a window
+// or GPU. Reports per-frame CPU time, vertex/index counts and heap allocations.
+//
+// Usage: gui_frame_bench [frames_per_scenario] [message_counts...]
+//        gui_frame_bench 300 1000 100000 1000000
+#include "gui/ChatLog.hpp"
+#include "gui/ChatLogView.hpp"
+#include "imgui.h"
+#include "imgui_impl_null.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+// ====================================================================
+// Allocation counting (operator new plus ImGui's allocator hooks)
+// ====================================================================
+static std::atomic<size_t> g_allocations{0};
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+static void* imgui_alloc(size_t size, void*) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size);
+}
+
+static void imgui_free(void* p, void*) {
+    std::free(p);
+}
+
+// ====================================================================
+// Synthetic chat history
+// ====================================================================
+static uint32_t next_random(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+static void fill_log(ChatLog& log, size_t count) {
+    static const char* words[] = {"hello", "world", "socket", "latency", "frame", "message", "chat",
+                                  "server", "client", "buffer", "render", "the", "a", "is", "ok"};
+    uint32_t state = 12345;
+    std::string text;
+    for (size_t i = 0; i < count; ++i) {
+        text.clear();
+        size_t word_count = 2 + next_random(state) % 60;
+        for (size_t w = 0; w < word_count; ++w) {
+            if (w) text.push_back(next_random(state) % 25 == 0 ? '\n' : ' ');
+            text.append(words[next_random(state) % (sizeof(words) / sizeof(words[0]))]);
+        }
+        std::string sender = "user" + std::to_string(next_random(state) % 50);
+        log.append(sender, text, (int64_t)i * 1000);
+    }
+}
+
+// ====================================================================
+// Frame driver
+// ====================================================================
+struct Scenario {
+    const char* name;
+    int frames;
+    // Called before each frame: may scroll, resize or append
+    std::function<void(int frame, ChatLog& log, float& width, float& scroll_fraction)> step;
+};
+
+static void run_frame(ChatLog& log, ChatLogView& view, float width, float scroll_fraction) {
+    ImGui_ImplNull_NewFrame();
+    ImGui::GetIO().DisplaySize = ImVec2(width, 700.0f);
+    ImGui::NewFrame();
+
+    // Mirrors ChatGui::render_chat_window
+    ImGui::SetNextWindowPos(ImVec2(0, ImGui::GetFrameHeight()), ImGuiCond_Always);
+    ImGui::SetNextWindowSize(ImVec2(width, 700.0f - ImGui::GetFrameHeight() - 80), ImGuiCond_Always);
+    ImGui::Begin("Chat Log", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize);
+    ImGui::BeginChild("chat_log", ImVec2(0, -30), false, ImGuiWindowFlags_HorizontalScrollbar);
+    if (scroll_fraction >= 0.0f) {
+        ImGui::SetScrollY(scroll_fraction * view.content_height());
+    }
+    view.draw(log);
+    if (scroll_fraction < 0.0f) {
+        ImGui::SetScrollHereY(1.0f);
+    }
+    ImGui::EndChild();
+    ImGui::End();
+
+    ImGui::Render();
+    ImGui_ImplNullRender_RenderDrawData(ImGui::GetDrawData());
+}
+
+static void run_scenario(size_t message_count, const Scenario& scenario) {
+    ChatLog log(std::max<size_t>(message_count, 1));
+    fill_log(log, message_count);
+
+    ImGui::CreateContext();
+    ImGui::GetIO().IniFilename = nullptr;  // no imgui.ini left behind in the working directory
+    ImGui_ImplNull_Init();
+    ChatLogView view;
+
+    // Warm-up frame: font atlas, first layout of the whole log
+    float width = 1000.0f;
+    float scroll_fraction = -1.0f;  // < 0 follows the tail
+    auto warm_start = std::chrono::steady_clock::now();
+    run_frame(log, view, width, scroll_fraction);
+    run_frame(log, view, width, scroll_fraction);
+    double warm_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - warm_start).count();
+
+    std::vector<double> times;
+    size_t vertices = 0;
+    size_t indices = 0;
+    size_t allocations_before = g_allocations.load();
+
+    for (int frame = 0; frame < scenario.frames; ++frame) {
+        scroll_fraction = -1.0f;
+        scenario.step(frame, log, width, scroll_fraction);
+
+        auto start = std::chrono::steady_clock::now();
+        run_frame(log, view, width, scroll_fraction);
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+        ImDrawData* draw_data = ImGui::GetDrawData();
+        vertices += (size_t)draw_data->TotalVtxCount;
+        indices += (size_t)draw_data->TotalIdxCount;
+    }
+    size_t allocations = g_allocations.load() - allocations_before;
+
+    std::sort(times.begin(), times.end());
+    double total = 0.0;
+    for (double t : times) total += t;
+    const size_t n = times.size();
+
+    std::printf("%9zu  %-8s %6zu  %8.3f  %8.3f  %8.3f  %8.3f  %7zu  %7zu  %8.1f  %9.1f  %8.1f\n",
+                message_count, scenario.name, n, total / n, times[n / 2], times[std::min(n - 1, n * 99 / 100)],
+                times.back(), vertices / n, indices / n, (double)allocations / n, warm_ms,
+                log.arena_bytes() / (1024.0 * 1024.0));
+
+    ImGui_ImplNull_Shutdown();
+    ImGui::DestroyContext();
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? std::atoi(argv[1]) : 300;
+    std::vector<size_t> counts;
+    for (int i = 2; i < argc; ++i) {
+        counts.push_back((size_t)std::strtoull(argv[i], nullptr, 10));
+    }
+    if (counts.empty()) {
+        counts = {1000, 100000, 1000000};
+    }
+
+    ImGui::SetAllocatorFunctions(imgui_alloc, imgui_free, nullptr);
+
+    const Scenario scenarios[] = {
+        // Following the tail while one message arrives per frame
+        {"tail", frames, [](int frame, ChatLog& log, float&, float&) {
+            log.append("live", "incoming message " + std::to_string(frame), 0);
+        }},
+        // Jumping around the scrollback
+        {"seek", frames, [](int frame, ChatLog&, float&, float& scroll_fraction) {
+            uint32_t state = (uint32_t)frame * 2654435761u;
+            scroll_fraction = (float)(next_random(state) % 1000) / 1000.0f;
+        }},
+        // Window width changing every frame (worst case: every height stale)
+        {"resize", std::max(1, frames / 10), [](int frame, ChatLog&, float& width, float&) {
+            width = frame % 2 ? 1000.0f : 760.0f;
+        }},
+    };
+
+    std::printf("%9s  %-8s %6s  %8s  %8s  %8s  %8s  %7s  %7s  %8s  %9s  %8s\n", "messages", "scenario", "frames",
+                "avg_ms", "p50_ms", "p99_ms", "max_ms", "vtx", "idx", "allocs", "warmup_ms", "arena_mb");
+    for (size_t count : counts) {
+        for (const Scenario& scenario : scenarios) {
+            run_scenario(count, scenario);
+        }
+    }
+    return 0;
+}
@@ -3,6 +3,9 @@
 int main() {
     ChatGui gui;
 
+    // Unlimited scrollback: messages evicted from memory are kept here across runs
+    gui.open_scrollback("chat_scrollback.log");
+
     if (!gui.init("Chat Client", 1000, 700)) {
         return 1;
     }
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+#include "storage/AppendFile.hpp"
+#include "storage/MappedFile.hpp"
+
+// Columnar export of room history for offline analytics (tools/history_export.cpp writes it,
+// tools/history_stats.cpp is an example reader).
+//
+// Layout, integers little-endian:
+//   "CHATCOL1"
+//   row groups: each group's column chunks back to back
+//   footer: the room and sender dictionaries, then per group its room, row count, first seq,
+//           first/min/max timestamp and each chunk's offset, size, decoded size and CRC-32C
+//   u32 CRC-32C of the footer, u64 footer size, "CHATCOL1"
+//
+// A row group holds up to ROWS_PER_GROUP messages of one room in seq order, one chunk per
+// column:
+//   COLUMN_SEQ     varint deltas from the previous seq (erased messages leave gaps)
+//   COLUMN_TIME    zigzag varint deltas from the previous timestamp
+//   COLUMN_SENDER  varint index into the sender dictionary
+//   COLUMN_LENGTH  varint text length in bytes
+//   COLUMN_TEXT    the texts back to back, LZ-compressed (storage/LzBlock.hpp)
+// A scan that leaves out the text column decodes a few bytes per message, and groups outside
+// a time range are skipped from the footer alone.
+
+// Column bits for ColumnFileReader::read(); chunk k of a group holds column 1 << k
+enum : unsigned {
+    COLUMN_SEQ = 1,
+    COLUMN_TIME = 2,
+    COLUMN_SENDER = 4,
+    COLUMN_LENGTH = 8,
+    COLUMN_TEXT = 16,
+    ALL_COLUMNS = 31,
+};
+constexpr size_t COLUMN_COUNT = 5;
+
+struct ColumnChunk {
+    uint64_t offset = 0;
+    uint64_t size = 0;          // stored bytes
+    uint64_t decoded_size = 0;  // after decompression (the text column), else == size
+    uint32_t crc = 0;           // of the stored bytes
+};
+
+struct ColumnGroup {
+    uint32_t room = 0;  // ColumnFileReader::rooms() index
+    uint64_t rows = 0;
+    uint64_t first_seq = 0;
+    int64_t first_ms = 0;
+    int64_t min_ms = 0;
+    int64_t max_ms = 0;
+    ColumnChunk chunks[COLUMN_COUNT];
+};
+
+// One group's decoded columns; those not asked for stay empty
+struct ColumnBatch {
+    uint32_t room = 0;
+    std::vector<uint64_t> seq;
+    std::vector<int64_t> timestamp_ms;
+    std::vector<uint32_t> sender;  // ColumnFileReader::senders() index
+    std::vector<uint32_t> length;  // text bytes
+    std::string text;              // every text back to back, in row order
+};
+
+/**
+ * Builds a column file from messages added room by room in seq order
+ * The file is written as <path>.tmp and renamed into place by close(), so readers never see
+ * a partial export.
+ */
+class ColumnFileWriter {
+public:
+    ColumnFileWriter();
+    ~ColumnFileWriter();  // an export that was not closed is abandoned
+
+    ColumnFileWriter(const ColumnFileWriter&) = delete;
+    ColumnFileWriter& operator=(const ColumnFileWriter&) = delete;
+
+    bool open(const std::string& path);
+    // A change of room, or a seq that does not ascend, starts a new row group
+    bool add(std::string_view room, uint64_t seq, int64_t timestamp_ms, std::string_view sender,
+             std::string_view text);
+    // Writes the last group and the footer, syncs and renames; false if anything failed
+    bool close();
+
+    static constexpr size_t ROWS_PER_GROUP = 65536;
+    static constexpr size_t TEXT_BYTES_PER_GROUP = 4 * 1024 * 1024;
+
+private:
+    AppendFile file_;
+    std::string path_;
+    bool failed_;
+    std::vector<std::string> rooms_;
+    std::vector<std::string> senders_;
+    std::unordered_map<std::string, uint32_t> room_ids_;
+    std::unordered_map<std::string, uint32_t> sender_ids_;
+    std::vector<ColumnGroup> groups_;
+
+    // The group being filled
+    ColumnGroup group_;
+    uint64_t last_seq_;
+    int64_t last_ms_;
+    std::string columns_[COLUMN_COUNT];  // the text column uncompressed until flushed
+    std::string compressed_;
+
+    bool flush_group();
+    bool write(const std::string& data, ColumnChunk& chunk);
+    static uint32_t intern(std::string_view name, std::vector<std::string>& names,
+                           std::unordered_map<std::string, uint32_t>& ids);
+};
+
+/**
+ * Reads a column file through a read-only mapping
+ * Only the footer is parsed up front; read() decodes just the columns asked for and verifies
+ * their checksums.
+ */
+class ColumnFileReader {
+public:
+    bool open(const std::string& path);  // false if the file is not a complete column file
+    void close();
+
+    const std::vector<std::string>& rooms() const;
+    const std::vector<std::string>& senders() const;
+    const std::vector<ColumnGroup>& groups() const;
+    uint64_t row_count() const;
+
+    // Decodes `columns` (COLUMN_* bits) of one group into `out`, reusing its capacity; false
+    // if a chunk is damaged or, when both are read, the lengths don't add up to the text size
+    bool read(size_t group, unsigned columns, ColumnBatch& out) const;
+
+private:
+    MappedFile file_;
+    std::string path_;
+    std::vector<std::string> rooms_;
+    std::vector<std::string> senders_;
+    std::vector<ColumnGroup> groups_;
+    uint64_t rows_ = 0;
+
+    bool parse_footer(const unsigned char* pos, const unsigned char* end, uint64_t data_end);
+};
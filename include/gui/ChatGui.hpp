@@ -1,11 +1,21 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
+#include <cstdint>
+#include "gui/ChatLog.hpp"
+#include "gui/ChatLogView.hpp"
+#include "gui/ChatSearchIndex.hpp"
+#include "gui/ScrollbackStore.hpp"
+#include "networking/UiDispatcher.hpp"
+#include "networking/MessageBuffer.hpp"
 
-// Forward declaration
+// Forward declarations
 class ChatClient;
+struct HistoryPage;
+enum class ConnectionState;
 
 /**
  * ImGui-based chat client GUI
@@ -29,18 +39,91 @@ public:
     void disconnect();
     bool is_connected() const;
 
+    // Scrollback length in lines (default ChatLog::DEFAULT_CAPACITY)
+    void set_history_capacity(size_t lines);
+    // Spill messages evicted from memory to an append-only file and page them back in when
+    // scrolling past the oldest in-memory one; history persists across runs. Call before init().
+    bool open_scrollback(const std::string& path);
+
 private:
+    UiDispatcher ui_dispatcher_;  // declared first: client callbacks may post until client_ is gone
     std::unique_ptr<ChatClient> client_;
-    std::vector<std::string> chat_log_;
+    ChatLog chat_log_;
+    ChatLogView chat_view_;
+    ChatSearchIndex search_index_;  // kept in step with chat_log_ (appends and evictions)
+    char search_buffer_[128];
+    std::vector<uint64_t> search_hits_;  // ascending stable indices of matching messages
+    uint64_t search_end_;                // log end index the hits are up to date with
+    size_t search_cursor_;               // selected hit, NO_HIT while following the tail
+    ScrollbackStore scrollback_;         // everything evicted from chat_log_, oldest first
+    ChatLog page_log_;                   // window of older history paged in from scrollback_
+    ChatLogView page_view_;
+    bool paging_;                        // page_view_ is on screen instead of the live log
+    // Room history from the server, paged in once local history runs out; row index == seq
+    std::string room_;                   // room of the sequenced messages being received
+    uint64_t room_first_seq_;            // oldest seq of room_ received this session
+    uint64_t room_first_row_;            // its chat_log_ index
+    ChatLog remote_log_;
+    ChatLogView remote_view_;
+    bool remote_paging_;                 // remote_view_ is on screen
+    bool remote_pending_;                // a fetch_history() is in flight
+    bool remote_exhausted_;              // the server holds nothing older than remote_log_
+    uint64_t remote_request_;            // answers to any other request are stale
+    float last_scroll_y_;
+    bool show_profiler_;
+    double last_rtt_poll_;  // glfwGetTime() of the last RTT query
+    std::vector<MessageView> incoming_;  // drain batch; capacity reused across frames
+    size_t backlog_;                     // messages left queued after this frame's drain
     char input_buffer_[512];
+    char user_buffer_[33];  // signs in as this on connect when not empty
     bool connected_;
+    ConnectionState last_state_;
     bool show_connection_status_;
     float scroll_to_bottom_;
+    int frames_to_draw_;  // extra frames after input so ImGui can settle hover/active states
 
     // Internal methods
+    void wait_for_events();
     void render_menu_bar();
     void render_chat_window();
     void render_input_area();
+    void render_search_bar();
+    void update_search(bool query_changed);
+    void select_hit(size_t hit);
+    void update_paging(bool scrolled_up);
+    void load_page(uint64_t anchor);
+    void update_remote_history(bool scrolled_up, bool pulled_past_bottom);
+    void fetch_remote(uint64_t before_seq, uint64_t count);
+    void on_history_page(const HistoryPage& page);
+    static void append_remote(ChatLog& log, const MessageView& message);
+    void leave_remote_history();
+    void render_profiler();
     void handle_incoming_messages();
-    void add_chat_message(const std::string& sender, const std::string& message);
+    void on_connection_state(ConnectionState state, const std::string& detail);
+    void add_chat_message(std::string_view sender, std::string_view message);
+    uint64_t store_message(std::string_view sender, std::string_view text, int64_t timestamp_ms);
+
+    // Longest idle sleep; keeps the input caret blinking while nothing else happens
+    static constexpr double IDLE_TIMEOUT_SECONDS = 0.5;
+    static constexpr int FRAMES_AFTER_EVENT = 3;
+
+    // Per-frame drain budget so floods (e.g. history replay) cannot stall a frame
+    static constexpr double DRAIN_BUDGET_MS = 4.0;
+    static constexpr size_t MAX_MESSAGES_PER_FRAME = 5000;
+    static constexpr size_t DRAIN_BATCH = 256;
+
+    static constexpr size_t NO_HIT = SIZE_MAX;
+
+    // Paged history: a window of PAGE_ROWS either side of the anchor row, re-centred when the
+    // viewport gets within PAGE_MARGIN_ROWS of either edge
+    static constexpr uint64_t PAGE_ROWS = 2000;
+    static constexpr uint64_t PAGE_MARGIN_ROWS = 200;
+
+    // Room history: REMOTE_PAGE_ROWS per request, sent when the viewport gets within
+    // REMOTE_MARGIN_ROWS of the oldest row; at most REMOTE_ROWS are held
+    static constexpr uint64_t REMOTE_PAGE_ROWS = 100;
+    static constexpr uint64_t REMOTE_MARGIN_ROWS = 30;
+    static constexpr size_t REMOTE_ROWS = 4000;
+
+    static constexpr double RTT_POLL_SECONDS = 1.0;
 };
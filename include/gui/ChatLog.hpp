@@ -0,0 +1,106 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+/**
+ * Compact record of one chat message; the text lives in the ChatLog arena
+ */
+struct ChatEntry {
+    uint32_t chunk;      // arena chunk sequence number
+    uint32_t offset;     // byte offset inside that chunk
+    uint32_t length;
+    uint32_t sender_id;  // index into the interned sender table
+    int64_t timestamp_ms;
+};
+
+/**
+ * Fixed-capacity circular chat history
+ * Appending is O(1); once full, each new message evicts the oldest one. Every message keeps
+ * a stable index (its position in the whole history), so the renderer can hold on to
+ * indices across appends and evictions.
+ *
+ * Message text is copied once into an append-only arena of large chunks and described by a
+ * 24-byte ChatEntry; sender names are interned and dropped with their last message. Chunks
+ * are released (or recycled) once every message in them has been evicted.
+ */
+class ChatLog {
+public:
+    using EvictHandler = std::function<void(uint64_t index)>;
+
+    explicit ChatLog(size_t capacity = DEFAULT_CAPACITY);
+
+    // Capacity management; shrinking keeps the newest messages
+    size_t capacity() const;
+    void set_capacity(size_t capacity);
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+    // Empties the log; the next message gets stable index first_index
+    void reset(uint64_t first_index);
+
+    // Stable indices: messages live in [first_index(), end_index())
+    uint64_t first_index() const;
+    uint64_t end_index() const;
+    bool contains(uint64_t index) const;
+    const ChatEntry& entry(uint64_t index) const;
+    std::string_view text(uint64_t index) const;
+    std::string_view sender(uint64_t index) const;
+
+    uint64_t append(std::string_view sender, std::string_view text, int64_t timestamp_ms);
+
+    // Called oldest-first just before a message is dropped (eviction, shrink or clear),
+    // while its text and sender are still readable
+    void on_evict(EvictHandler handler);
+
+    // Bytes held by the arena chunks (text storage only)
+    size_t arena_bytes() const;
+
+    static constexpr size_t DEFAULT_CAPACITY = 100000;
+    static constexpr size_t CHUNK_SIZE = 256 * 1024;
+
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t capacity;
+        size_t used;
+    };
+
+    // Record ring: grows up to capacity_ slots; slot = index % capacity_
+    std::vector<ChatEntry> entries_;
+    size_t capacity_;
+    uint64_t first_;
+    uint64_t end_;
+
+    // Arena: chunks_[i] has sequence number first_chunk_ + i
+    std::deque<Chunk> chunks_;
+    uint32_t first_chunk_;
+    Chunk spare_;  // one recycled chunk so steady-state appends do not hit the heap
+
+    // Interned sender names, each counted by the retained messages that use it; ids of
+    // senders with no messages left are reused
+    struct Sender {
+        std::string name;
+        size_t refs;
+    };
+    std::vector<Sender> senders_;
+    std::map<std::string, uint32_t, std::less<>> sender_ids_;
+    std::vector<uint32_t> free_sender_ids_;
+
+    EvictHandler evict_handler_;
+
+    // Internal methods
+    uint32_t intern_sender(std::string_view sender);
+    void release_senders(uint64_t first, uint64_t end);
+    void notify_evicted(uint64_t first, uint64_t end);
+    ChatEntry store_text(std::string_view text);
+    void evict_oldest();
+    void release_chunks();
+};
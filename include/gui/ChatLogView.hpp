@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+class ChatLog;
+
+/**
+ * Virtualized renderer for a ChatLog with word-wrapped, variable-height rows
+ * Keeps a per-row height cache keyed by wrap width, font size and item spacing, plus
+ * per-block height sums and their prefix sums, so scroll offset -> row lookup is a binary
+ * search over blocks and only visible rows are submitted to ImGui. Rows not seen since the
+ * last resize carry an estimate that is replaced by the measured height once drawn.
+ */
+class ChatLogView {
+public:
+    ChatLogView();
+
+    // Draw the log into the current ImGui window (between Begin/BeginChild and End)
+    void draw(const ChatLog& log);
+
+    // Total laid-out height of all rows, as of the last draw()
+    float content_height() const;
+
+    // Jump to a row: align 0 puts it at the top of the viewport, 0.5 centres it. The jump is
+    // issued by apply_scroll(), which must run right before the view's BeginChild so it lands
+    // in the same frame, and is repeated once after the rows around it have been measured.
+    void scroll_to(uint64_t index, float align = 0.5f);
+    void apply_scroll(const ChatLog& log);
+    bool scroll_pending() const;
+
+    // Oldest row intersecting the viewport in the last draw(), or NO_ROW
+    uint64_t first_visible() const;
+
+    // Tint one row, e.g. the selected search hit; NO_ROW clears it
+    void set_highlight(uint64_t index);
+
+    static constexpr uint64_t NO_ROW = UINT64_MAX;
+
+private:
+    struct RowLayout {
+        float height;
+        uint32_t epoch;     // layout_epoch_ the height was measured in; 0 = estimate
+        uint32_t newlines;  // cached so re-estimating after a resize never touches the text
+    };
+
+    // Layout key; any change starts a new epoch
+    float wrap_width_;
+    float font_size_;
+    float spacing_;
+    float char_width_;
+    uint32_t layout_epoch_;
+
+    // Rows and blocks are rings indexed by stable index (see ChatLog)
+    std::vector<RowLayout> rows_;
+    std::vector<float> block_heights_;
+    std::vector<float> block_prefix_;  // block_prefix_[k] = height above the k-th retained block
+    std::vector<uint64_t> dirty_blocks_;
+    uint64_t synced_first_;
+    uint64_t synced_end_;
+
+    // Viewport as of the last draw()
+    float origin_;       // cursor y where the rows start
+    float view_height_;
+    uint64_t first_visible_;
+
+    uint64_t scroll_target_;
+    float scroll_align_;
+    int scroll_passes_;  // frames left that re-issue the jump as estimates become measurements
+    uint64_t highlight_;
+
+    std::string scratch_;  // "[sender]: text" of the row being drawn; capacity is reused
+
+    // Internal methods
+    std::string_view format_row(const ChatLog& log, uint64_t index);
+    void sync(const ChatLog& log, float wrap_width, float font_size, float spacing);
+    void relayout_all(const ChatLog& log, bool rows_known);
+    void init_row(const ChatLog& log, uint64_t index, bool count_newlines);
+    float estimate_height(const RowLayout& layout, size_t length) const;
+    void store_measured(uint64_t index, float height);
+    void rebuild_blocks(const ChatLog& log);
+    void rebuild_prefix();
+    uint64_t row_at(float y) const;
+    float row_top(uint64_t index) const;
+
+    RowLayout& row(uint64_t index) { return rows_[index % rows_.size()]; }
+    const RowLayout& row(uint64_t index) const { return rows_[index % rows_.size()]; }
+    float& block(uint64_t block_id) { return block_heights_[block_id % block_heights_.size()]; }
+    float block(uint64_t block_id) const { return block_heights_[block_id % block_heights_.size()]; }
+
+    static constexpr uint64_t BLOCK_ROWS = 64;
+    static constexpr int SCROLL_PASSES = 2;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Incremental inverted index over ChatLog messages
+ * Terms are runs of letters/digits (ASCII case-folded; UTF-8 sequences kept as-is) taken
+ * from the sender and the text. Each term maps to the ascending stable indices of the
+ * messages containing it. Messages are added as they are appended and removed as the log
+ * evicts them (always oldest first), so postings only ever grow at the back and shrink at
+ * the front.
+ */
+class ChatSearchIndex {
+public:
+    ChatSearchIndex();
+
+    void add(uint64_t index, std::string_view sender, std::string_view text);
+    // Must be called with the oldest indexed message, i.e. from ChatLog's evict handler
+    void remove(uint64_t index, std::string_view sender, std::string_view text);
+    void clear();
+
+    // Appends the indices >= from_index that contain every query term, ascending. The last
+    // term matches as a prefix unless the query ends in a separator (search-as-you-type).
+    // Returns false if the query has no terms.
+    bool search(std::string_view query, std::vector<uint64_t>& out, uint64_t from_index = 0);
+
+    size_t term_count() const;
+    size_t posting_count() const;
+
+private:
+    struct Postings {
+        std::vector<uint64_t> indices;
+        size_t head = 0;  // indices before head belong to evicted messages
+    };
+
+    std::map<std::string, Postings, std::less<>> terms_;
+    size_t posting_count_;
+
+    // Scratch space reused across calls
+    std::string folded_;
+    std::vector<std::string_view> tokens_;
+    std::vector<uint64_t> prefix_hits_;
+
+    // Internal methods
+    void tokenize(std::string_view sender, std::string_view text);
+
+    // Prefix matches merge at most this many terms so one-letter queries stay cheap
+    static constexpr size_t MAX_PREFIX_TERMS = 256;
+    static constexpr size_t MAX_TERM_LENGTH = 32;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+// Scoped timers are compiled into debug builds, or into any build configured with
+// CHAT_PROFILER=1 (CMake option CHAT_PROFILER) for diagnosing release builds in the field
+#ifndef CHAT_PROFILER
+#ifdef NDEBUG
+#define CHAT_PROFILER 0
+#else
+#define CHAT_PROFILER 1
+#endif
+#endif
+
+#if CHAT_PROFILER
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(section) FrameProfiler::Scope PROFILE_CONCAT(profile_scope_, __LINE__)(FrameProfiler::section)
+#else
+#define PROFILE_SCOPE(section) ((void)0)
+#endif
+
+/**
+ * Per-frame CPU time breakdown for the GUI thread
+ * Scopes nest and record exclusive time, so a Layout scope inside a Submit scope is not
+ * counted twice. Keeps the last HISTORY_FRAMES frames plus message rate, queue depth and
+ * RTT for the overlay. GUI thread only.
+ */
+class FrameProfiler {
+public:
+    enum Section { Drain, Layout, Submit, Render, SECTION_COUNT };
+
+    static FrameProfiler& instance();
+
+    // Bracket the measured part of a frame (excluding the idle wait and the vsync swap)
+    void begin_frame();
+    void end_frame();
+
+    void add_messages(size_t count);
+    void set_queue_depth(size_t depth);
+    void set_rtt(double ms);  // negative = unknown
+
+    void draw_overlay(bool* open);
+
+    class Scope {
+    public:
+        explicit Scope(Section section);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        FrameProfiler& profiler_;
+        Section section_;
+        std::chrono::steady_clock::time_point start_;
+        double child_ms_;
+        Scope* parent_;
+    };
+
+    static constexpr size_t HISTORY_FRAMES = 120;
+
+private:
+    FrameProfiler();
+
+    Scope* current_;
+    double section_ms_[SECTION_COUNT];  // this frame, exclusive
+    std::chrono::steady_clock::time_point frame_start_;
+
+    // Ring of recent frames; row SECTION_COUNT holds the frame total
+    float history_[SECTION_COUNT + 1][HISTORY_FRAMES];
+    size_t history_pos_;
+    size_t history_count_;
+
+    size_t rate_messages_;
+    std::chrono::steady_clock::time_point rate_start_;
+    double messages_per_second_;
+    size_t queue_depth_;
+    double rtt_ms_;
+};
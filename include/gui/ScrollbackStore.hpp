@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "storage/AppendFile.hpp"
+#include "storage/MappedFile.hpp"
+
+/**
+ * Disk-backed scrollback for messages evicted from the in-memory ChatLog
+ * Evicted messages are appended to a file of length-prefixed records, keeping their
+ * stable indices (which continue across runs). A sidecar "<path>.idx" file holds the
+ * offset of every SPARSE_EVERY-th record, so reopening reads that small index and scans
+ * only the unindexed tail, and a lookup is one index probe plus a short forward scan.
+ * Reads go through a read-only mapping, so paged-in history lives in the OS page cache
+ * rather than in process memory.
+ */
+class ScrollbackStore {
+public:
+    struct Record {
+        std::string_view sender;
+        std::string_view text;
+        int64_t timestamp_ms;
+    };
+
+    ScrollbackStore();
+    ~ScrollbackStore();
+
+    ScrollbackStore(const ScrollbackStore&) = delete;
+    ScrollbackStore& operator=(const ScrollbackStore&) = delete;
+
+    // Creates or reopens the store; a torn tail from a crash is dropped
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const;
+
+    // Stored messages have indices [0, end_index())
+    uint64_t end_index() const;
+
+    // Appends must be contiguous (index == end_index()); they are buffered until flush()
+    bool append(uint64_t index, std::string_view sender, std::string_view text, int64_t timestamp_ms);
+    bool flush();
+
+    // The views stay valid until the next read() or close()
+    bool read(uint64_t index, Record& out);
+
+    static constexpr uint64_t SPARSE_EVERY = 64;
+
+private:
+    std::string path_;
+    AppendFile data_file_;
+    AppendFile index_file_;
+    MappedFile data_map_;
+
+    std::vector<uint64_t> sparse_;  // sparse_[k] = file offset of record k * SPARSE_EVERY
+    size_t indexed_;                // sparse_ entries already written to index_file_
+    uint64_t end_index_;
+    std::string pending_;           // encoded records not yet written to data_file_
+
+    // Position after the last read, so paging through consecutive records never rescans
+    uint64_t cursor_index_;
+    uint64_t cursor_offset_;
+
+    // Internal methods
+    bool recover();
+    bool ensure_mapped(uint64_t end);
+
+    static constexpr char MAGIC[8] = {'C', 'H', 'A', 'T', 'S', 'B', '0', '1'};
+    // Record: u32 text length, u32 sender length, i64 timestamp, sender bytes, text bytes
+    static constexpr size_t RECORD_HEADER_SIZE = 16;
+    static constexpr size_t FLUSH_THRESHOLD = 64 * 1024;
+};
@@ -1,49 +1,224 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <queue>
+#include <map>
+#include <utility>
 #include <mutex>
-#include <thread>
+#include <condition_variable>
 #include <atomic>
 #include <memory>
+#include <chrono>
+#include <functional>
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include "networking/NetRuntime.hpp"
+#include "networking/MessageBuffer.hpp"
+#include "networking/ChatProtocol.hpp"
+
+/**
+ * Connection lifecycle reported by ChatClient::state()
+ */
+enum class ConnectionState {
+    Disconnected,
+    Resolving,
+    Connecting,
+    Connected,
+    Failed
+};
+
+/**
+ * One page of a room's stored history, as answered by the server
+ */
+struct HistoryPage {
+    std::string room;
+    std::vector<MessageView> messages;  // oldest first; erased ones are `deleted` placeholders
+    uint64_t first_seq = 0;             // oldest message the server still stores (0 if none)
+    bool complete = false;              // false if the session ended before the answer
+};
 
 /**
  * Thread-safe chat client using Windows Sockets
- * Manages connection, sending, and receiving messages in non-blocking mode
+ * A lightweight session driven by the shared NetRuntime event loop; any number of
+ * clients can live in one process without a thread each. The byte stream is split into
+ * '\n'-terminated frames; each frame is delivered as one message without the terminator.
+ * Sequenced chat frames (see ChatProtocol.hpp) are delivered once each: duplicates are
+ * dropped, and a jump in a room's seqs sends a /resend for just the missing range, whose
+ * messages are then delivered as they arrive. Older history is paged in on demand with
+ * fetch_history() and searched with search_history(); their messages go to the request's
+ * callback, not the message stream.
+ *
+ * Callback threading contract: callbacks run on the NetRuntime loop thread (state changes
+ * may also be reported on the thread calling connect_async()/disconnect()), never while
+ * ChatClient locks are held. They are shared by every session in the process, so they must
+ * not block; calling send_message() or disconnect() from a callback is allowed. Use
+ * UiDispatcher to hop onto a UI thread instead.
  */
 class ChatClient {
 public:
+    using StateCallback = std::function<void(ConnectionState state, const std::string& detail)>;
+    // The view may be copied to keep the underlying buffer alive past the callback
+    using MessageCallback = std::function<void(const MessageView& message)>;
+    using WakeCallback = std::function<void()>;
+    using HistoryCallback = std::function<void(const HistoryPage& page)>;
+
     ChatClient();
     ~ChatClient();
 
+    ChatClient(const ChatClient&) = delete;
+    ChatClient& operator=(const ChatClient&) = delete;
+
     // Connection management
-    bool connect(const std::string& host, int port);
+    bool connect(const std::string& host, int port);  // blocking; not from the loop thread
+    bool connect_async(const std::string& host, int port,
+                       std::chrono::milliseconds timeout = DEFAULT_CONNECT_TIMEOUT);
     void disconnect();
     bool is_connected() const;
+    ConnectionState state() const;
+    void on_state_change(StateCallback callback);
 
     // Message operations
+    // Opt-in push delivery: while a message callback is set, messages bypass the receive queue
+    void on_message(MessageCallback callback);
+    // Pull-mode wakeup: fires when the receive queue goes from empty to non-empty
+    void on_messages_pending(WakeCallback callback);
     bool send_message(const std::string& message);
     bool has_pending_messages() const;
-    std::string receive_message();
+    size_t pending_count() const;
+    bool receive_view(MessageView& out);  // zero-copy
+    size_t receive_views(std::vector<MessageView>& out, size_t max_count);  // appends, one lock
+    std::string receive_message();        // copying convenience wrapper
+
+    // History paging: up to `count` messages below before_seq (0 = the newest), or the oldest
+    // in [from, to). The callback runs once on the loop thread; false (and no callback) if
+    // the request could not be sent.
+    bool fetch_history(const std::string& room, uint64_t before_seq, size_t count, HistoryCallback callback);
+    bool fetch_history(const std::string& room, std::chrono::system_clock::time_point from,
+                       std::chrono::system_clock::time_point to, size_t count, HistoryCallback callback);
+    // Server-side full-text search: the newest `count` messages below before_seq (0 = the
+    // newest) containing every word of `query`, delivered like a history page
+    bool search_history(const std::string& room, const std::string& query, uint64_t before_seq, size_t count,
+                        HistoryCallback callback);
+    // Erases one of this connection's own messages from the room's stored history; the server
+    // answers with a notice
+    bool delete_message(const std::string& room, uint64_t seq);
+
+    // Integrity: from the next connection on, every line sent ends in a CRC-32C that the
+    // server verifies (see ChatProtocol.hpp)
+    void set_frame_checksums(bool enabled);
+    // Offline delivery: from the next connection on, signs in as `name` (letters, digits, - and
+    // _; empty = anonymous). Messages sent to the user's rooms while no connection was signed in
+    // are streamed right after connecting, and the user's messages carry the name.
+    void set_user(const std::string& name);
+
+    // Kernel's smoothed round-trip estimate for the connection (SIO_TCP_INFO); false if unavailable
+    bool round_trip_time(std::chrono::microseconds& out);
+
+    static constexpr std::chrono::milliseconds DEFAULT_CONNECT_TIMEOUT{5000};
 
 private:
+    // One in-flight connect: resolution, staggered attempts and their timers (loop thread only)
+    struct ConnectAttempt {
+        std::string host;
+        int port;
+        std::vector<ResolvedAddress> candidates;
+        size_t next_candidate = 0;
+        std::vector<SOCKET> pending;
+        NetRuntime::TimerId deadline_timer = 0;
+        NetRuntime::TimerId stagger_timer = 0;
+        int last_error = 0;
+    };
+
+    NetRuntime& runtime_;
     SOCKET socket_;
     std::atomic<bool> connected_;
     std::atomic<bool> running_;
+    std::shared_ptr<ConnectAttempt> attempt_;
+    std::atomic<bool> frame_checksums_;
+
+    // Connection state, guarded by state_mutex_
+    ConnectionState state_;
+    StateCallback state_callback_;
+    mutable std::mutex state_mutex_;
+    std::condition_variable state_cv_;
 
     // Thread-safe message queue
-    std::queue<std::string> message_queue_;
+    std::queue<MessageView> message_queue_;
     mutable std::mutex queue_mutex_;
 
-    // Receive thread
-    std::unique_ptr<std::thread> recv_thread_;
+    // Push delivery and wakeups (loop thread only; installed via NetRuntime::run_sync)
+    MessageCallback message_callback_;
+    WakeCallback pending_callback_;
+
+    // Reassembly buffer (loop thread only): [recv_begin_, recv_end_) holds bytes of frames
+    // not yet complete, scan_pos_ is where the search for the next '\n' resumes
+    BufferRef recv_buffer_;
+    size_t recv_begin_;
+    size_t recv_end_;
+    size_t scan_pos_;
+
+    // Per-room sequence tracking (loop thread only), reset for each connection
+    struct RoomSequence {
+        uint64_t first_seq = 0;                               // nothing below this was seen or requested
+        uint64_t next_seq = 0;                                // one past the newest seq seen
+        std::vector<std::pair<uint64_t, uint64_t>> missing;  // requested, not yet received
+    };
+    std::map<std::string, RoomSequence, std::less<>> sequences_;
+
+    // History requests awaiting HEND, by request id, guarded by history_mutex_
+    struct PendingHistory {
+        HistoryPage page;
+        HistoryCallback callback;
+    };
+    std::map<uint64_t, PendingHistory> history_requests_;
+    uint64_t next_history_id_;
+    std::mutex history_mutex_;
+
+    // Bytes the kernel would not take yet; also guards socket_ against close during send
+    std::string send_buffer_;
+    bool session_checksums_;  // this connection's lines carry checksums
+    std::string user_;        // signed in as on connect (set_user)
+    std::mutex send_mutex_;
+
+    // Connect state machine (loop thread only)
+    void start_connect(const std::shared_ptr<ConnectAttempt>& attempt, std::chrono::milliseconds timeout);
+    void start_next_attempt(const std::shared_ptr<ConnectAttempt>& attempt);
+    void on_connect_event(const std::shared_ptr<ConnectAttempt>& attempt, SOCKET sock, short revents);
+    void finish_connect(const std::shared_ptr<ConnectAttempt>& attempt, SOCKET sock);
+    void fail_connect(const std::shared_ptr<ConnectAttempt>& attempt, const std::string& error);
+    void abandon_attempt(const std::shared_ptr<ConnectAttempt>& attempt);
+
+    // Connected session (loop thread only)
+    void on_socket_event(short revents);
+    void on_readable();
+    void prepare_recv_buffer();
+    void extract_frames();
+    void reset_recv_buffer();
+    void flush_send_buffer();
+    void close_session(const std::string& notice, const std::string& reason);
+    void teardown();
 
-    // Internal methods
-    void recv_loop();
-    void cleanup();
+    void deliver_frame(MessageView frame);
+    bool track_sequence(std::string_view room, uint64_t first_seq, uint64_t last_seq);
+    void request_resend(const std::string& room, RoomSequence& sequence, uint64_t first_seq, uint64_t last_seq);
+    void expect_missed(const MissedFrame& missed);
+    bool request_history(const std::string& room, HistoryCallback callback,
+                         const std::function<std::string(uint64_t id)>& format_command);
+    bool deliver_history(const MessageView& frame);
+    void fail_history_requests();
+    void push_message(MessageView message);
+    void push_notice(const std::string& notice);
+    void set_state(ConnectionState state, const std::string& detail = "");
 
-    static constexpr int BUFFER_SIZE = 4096;
+    static constexpr size_t RECV_BUFFER_SIZE = 16 * 1024;
+    // Longer frames are delivered in MAX_FRAME_SIZE pieces rather than growing without bound
+    static constexpr size_t MAX_FRAME_SIZE = 1024 * 1024;
     static constexpr int PORT_DEFAULT = 54000;
+    // Bound the reads per readiness event so one busy session cannot starve the others
+    static constexpr int MAX_READS_PER_EVENT = 16;
+    // RFC 8305 "Connection Attempt Delay" between staggered attempts
+    static constexpr std::chrono::milliseconds ATTEMPT_DELAY{250};
+    // Outstanding resend ranges kept per room; the oldest is given up beyond this
+    static constexpr size_t MAX_MISSING_RANGES = 64;
 };
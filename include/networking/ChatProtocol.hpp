@@ -0,0 +1,122 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// Wire protocol: '\n'-terminated text lines in both directions.
+//
+// Client -> server: chat text, or a command
+//   /join <room>
+//   /resend <room> <first_seq> <last_seq>    (inclusive, at most MAX_RESEND messages)
+//   /history <id> <room> before <seq> <count>              newest messages below seq (0 = latest)
+//   /history <id> <room> between <from_ms> <to_ms> <count> oldest messages in [from_ms, to_ms)
+//   /search <id> <room> <before_seq> <count> <query>       newest matches below seq (0 = latest)
+//   /delete <room> <seq>                                   erases one of the client's own messages
+//   /checksums                                             the client's later lines carry checksums
+//   /user <name>                                           signs in; later messages are sent as <name>
+//
+// Server -> client:
+//   MSG <room> <seq> <timestamp_ms> <sender> <text>   a chat message; seq is per room, from 1
+//   DEL <room> <seq> <timestamp_ms>                   stands in for an erased message wherever a
+//                                                     stored one is sent, so seqs stay consecutive
+//   ACK <room> <first_seq> <last_seq>                 seqs given to the client's own messages
+//   HIS <id> MSG ... | HIS <id> DEL ...               one /history or /search result, oldest first
+//   HEND <id> <room> <count> <first_seq>              end of results; first_seq = oldest stored
+//   MISSED <room> <first_seq> <last_seq>              MSG frames in this range that the signed-in user
+//                                                     has not been sent follow, possibly interleaved
+//                                                     with live frames
+//   anything else                                     a notice such as "[SYSTEM] ..."
+//
+// Room and sender names never contain spaces.
+//
+// After /checksums, every line the client sends ends in " *" and eight hex digits of the
+// CRC-32C of the line before them; the server drops lines whose checksum does not match.
+
+struct ChatFrame {
+    std::string_view room;
+    std::string_view sender;
+    std::string_view text;
+    uint64_t seq;
+    int64_t timestamp_ms;
+    bool deleted;  // a DEL frame: sender and text are empty
+};
+
+struct AckFrame {
+    std::string_view room;
+    uint64_t first_seq;
+    uint64_t last_seq;
+};
+
+struct MissedFrame {
+    std::string_view room;
+    uint64_t first_seq;
+    uint64_t last_seq;
+};
+
+struct HistoryQuery {
+    uint64_t id = 0;
+    std::string_view room;
+    bool by_time = false;
+    uint64_t before_seq = 0;  // by seq
+    int64_t from_ms = 0;      // by time
+    int64_t to_ms = 0;
+    uint64_t count = 0;
+};
+
+struct SearchQuery {
+    uint64_t id = 0;
+    std::string_view room;
+    uint64_t before_seq = 0;
+    uint64_t count = 0;
+    std::string_view text;  // every word must occur; the last one may be a prefix
+};
+
+struct HistoryEnd {
+    uint64_t id;
+    std::string_view room;
+    uint64_t count;
+    uint64_t first_seq;
+};
+
+// Writes "MSG <room> <seq> <timestamp_ms> <sender> " (without the text) into `out`, which
+// must hold MAX_FRAME_HEADER bytes; long names are cut short. Returns the length.
+size_t format_chat_header(char* out, std::string_view room, uint64_t seq, int64_t timestamp_ms,
+                          std::string_view sender);
+// Writes "DEL <room> <seq> <timestamp_ms>" (without the newline) the same way
+size_t format_deleted_frame(char* out, std::string_view room, uint64_t seq, int64_t timestamp_ms);
+
+// A MSG or DEL frame
+bool parse_chat_frame(std::string_view line, ChatFrame& out);
+bool parse_ack_frame(std::string_view line, AckFrame& out);
+std::string format_missed_frame(std::string_view room, uint64_t first_seq, uint64_t last_seq);
+bool parse_missed_frame(std::string_view line, MissedFrame& out);
+
+std::string format_resend_command(std::string_view room, uint64_t first_seq, uint64_t last_seq);
+bool parse_resend_command(std::string_view line, std::string_view& room, uint64_t& first_seq, uint64_t& last_seq);
+
+std::string format_delete_command(std::string_view room, uint64_t seq);
+bool parse_delete_command(std::string_view line, std::string_view& room, uint64_t& seq);
+
+std::string format_user_command(std::string_view name);
+bool parse_user_command(std::string_view line, std::string_view& name);
+
+std::string format_history_command(const HistoryQuery& query);
+bool parse_history_command(std::string_view line, HistoryQuery& out);
+std::string format_search_command(const SearchQuery& query);
+bool parse_search_command(std::string_view line, SearchQuery& out);
+// A HIS line: its request id, and the MSG frame it wraps
+bool parse_history_frame(std::string_view line, uint64_t& id, ChatFrame& out);
+bool parse_history_end(std::string_view line, HistoryEnd& out);
+
+// Appends `line` followed by its checksum suffix (no newline)
+void append_frame_checksum(std::string& out, std::string_view line);
+// Verifies and removes the checksum suffix; false if it is missing or does not match
+bool strip_frame_checksum(std::string_view& line);
+
+constexpr size_t MAX_FRAME_NAME = 64;
+constexpr size_t MAX_FRAME_HEADER = 4 + (MAX_FRAME_NAME + 1) * 2 + (20 + 1) * 2;
+constexpr uint64_t MAX_RESEND = 1000;
+constexpr uint64_t MAX_HISTORY_PAGE = 500;
+constexpr size_t FRAME_CHECKSUM_SIZE = 10;  // " *" + 8 hex digits
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+/**
+ * Reference-counted byte block recycled through BufferPool
+ * Received bytes live here and consumers see them through MessageView, so the path from
+ * socket to consumer needs no intermediate std::string.
+ */
+class MessageBuffer {
+public:
+    char* data() { return data_.get(); }
+    const char* data() const { return data_.get(); }
+    size_t capacity() const { return capacity_; }
+
+private:
+    friend class BufferPool;
+    friend class BufferRef;
+
+    explicit MessageBuffer(size_t capacity);
+
+    std::unique_ptr<char[]> data_;
+    size_t capacity_;
+    std::atomic<uint32_t> refs_;
+};
+
+/**
+ * Intrusive handle to a MessageBuffer; the last handle returns the buffer to the pool
+ */
+class BufferRef {
+public:
+    BufferRef() = default;
+    BufferRef(const BufferRef& other);
+    BufferRef(BufferRef&& other) noexcept;
+    BufferRef& operator=(const BufferRef& other);
+    BufferRef& operator=(BufferRef&& other) noexcept;
+    ~BufferRef();
+
+    MessageBuffer* get() const { return buffer_; }
+    MessageBuffer* operator->() const { return buffer_; }
+    explicit operator bool() const { return buffer_ != nullptr; }
+
+    // True when no other handle shares the buffer, i.e. it may be overwritten in place
+    bool unique() const;
+    void reset();
+
+private:
+    friend class BufferPool;
+    explicit BufferRef(MessageBuffer* buffer);
+
+    MessageBuffer* buffer_ = nullptr;
+};
+
+/**
+ * Process-wide free list of MessageBuffers
+ * Steady-state receive traffic reuses cached blocks instead of hitting the heap. A cached
+ * block is only handed out for a request at least half its size, and blocks above
+ * MAX_CACHED_CAPACITY are freed on release, so a small message never pins a large block.
+ */
+class BufferPool {
+public:
+    static BufferPool& instance();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    BufferRef acquire(size_t min_capacity);
+    BufferRef copy_of(std::string_view text);
+
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+private:
+    friend class BufferRef;
+
+    BufferPool() = default;
+    ~BufferPool();
+
+    void release(MessageBuffer* buffer);
+
+    std::vector<MessageBuffer*> free_;
+    std::mutex mutex_;
+
+    static constexpr size_t MAX_CACHED = 256;
+    static constexpr size_t MAX_CACHED_CAPACITY = 64 * 1024;
+};
+
+/**
+ * A received message viewed in place inside a pooled buffer
+ * The view stays valid for as long as the MessageView (or a copy of it) is alive.
+ */
+struct MessageView {
+    std::string_view text;
+    BufferRef buffer;
+
+    // Chat messages relayed by the server (MSG frames) also carry these, viewed in the same
+    // buffer; notices leave them empty / zero
+    std::string_view room{};
+    std::string_view sender{};
+    uint64_t seq = 0;
+    int64_t timestamp_ms = 0;
+    bool late = false;     // fills a gap below newer messages already delivered (a resend, or missed while away)
+    bool deleted = false;  // an erased message's placeholder in a history page (text and sender empty)
+
+    std::string to_string() const { return std::string(text); }
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <cstdint>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+/**
+ * A resolved socket address, copied out of getaddrinfo() results
+ */
+struct ResolvedAddress {
+    int family;
+    int socktype;
+    int protocol;
+    sockaddr_storage addr;
+    int addrlen;
+};
+
+/**
+ * Process-wide network runtime
+ * Owns Winsock initialization, one WSAPoll event loop thread that multiplexes every
+ * ChatClient session in the process, and a small pool of name-resolution threads.
+ *
+ * Threading contract: post(), run_sync() and resolve() may be called from any thread.
+ * watch()/unwatch()/add_timer()/cancel_timer() must be called on the loop thread, and
+ * every handler runs on the loop thread.
+ */
+class NetRuntime {
+public:
+    using Task = std::function<void()>;
+    using IoHandler = std::function<void(short revents)>;
+    using ResolveHandler = std::function<void(const std::vector<ResolvedAddress>& addresses, int error)>;
+    using TimerId = uint64_t;
+
+    static NetRuntime& instance();
+
+    NetRuntime(const NetRuntime&) = delete;
+    NetRuntime& operator=(const NetRuntime&) = delete;
+
+    bool is_running() const;
+    bool in_loop_thread() const;
+
+    // Task scheduling
+    void post(Task task);
+    void run_sync(Task task);
+
+    // Socket readiness (loop thread only)
+    void watch(SOCKET sock, short events, IoHandler handler);
+    void modify(SOCKET sock, short events);
+    void unwatch(SOCKET sock);
+
+    // Timers (loop thread only)
+    TimerId add_timer(std::chrono::milliseconds delay, Task task);
+    void cancel_timer(TimerId id);
+
+    // Name resolution on the resolver pool; handler runs on the loop thread
+    void resolve(const std::string& host, int port, ResolveHandler handler);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Watch {
+        short events;
+        std::shared_ptr<IoHandler> handler;
+    };
+
+    struct ResolveJob {
+        std::string host;
+        int port;
+        ResolveHandler handler;
+    };
+
+    NetRuntime();
+    ~NetRuntime();
+
+    std::atomic<bool> running_;
+    bool wsa_started_;
+
+    // Event loop (loop thread only, except wake sockets)
+    std::thread loop_thread_;
+    SOCKET wake_socket_;
+    std::atomic<bool> wake_pending_;
+    std::unordered_map<SOCKET, Watch> watches_;
+    std::vector<WSAPOLLFD> poll_fds_;
+    bool poll_fds_dirty_;
+
+    // Timers ordered by deadline (loop thread only)
+    std::map<std::pair<Clock::time_point, TimerId>, Task> timers_;
+    std::unordered_map<TimerId, Clock::time_point> timer_deadlines_;
+    TimerId next_timer_id_;
+
+    // Cross-thread task queue
+    std::vector<Task> tasks_;
+    std::mutex tasks_mutex_;
+
+    // Resolver pool
+    std::vector<std::thread> resolver_threads_;
+    std::vector<ResolveJob> resolve_jobs_;
+    std::mutex resolve_mutex_;
+    std::condition_variable resolve_cv_;
+
+    // Internal methods
+    bool open_wake_socket();
+    void wake();
+    void loop();
+    void run_tasks();
+    void run_timers();
+    int next_timeout_ms() const;
+    void resolver_loop();
+
+    static constexpr int RESOLVER_THREADS = 2;
+};
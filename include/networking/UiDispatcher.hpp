@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+
+// Forward declarations
+class ChatClient;
+enum class ConnectionState;
+struct MessageView;
+
+/**
+ * Hands ChatClient callbacks over to a UI thread
+ * post() may be called from any thread; drain() runs the queued work on the thread that
+ * calls it, typically once per frame. Must outlive every client attached to it.
+ */
+class UiDispatcher {
+public:
+    using Task = std::function<void()>;
+    using MessageHandler = std::function<void(const MessageView& message)>;
+    using StateHandler = std::function<void(ConnectionState state, const std::string& detail)>;
+
+    // Install callbacks on the client that re-post into this queue; null handlers are skipped
+    void attach(ChatClient& client, MessageHandler on_message, StateHandler on_state);
+
+    // Called from the posting thread when the queue goes from empty to non-empty,
+    // e.g. to kick a UI loop out of an idle wait
+    void set_wake_handler(Task handler);
+
+    void post(Task task);
+    size_t drain();
+    bool empty() const;
+
+private:
+    Task wake_handler_;
+    std::vector<Task> tasks_;
+    std::vector<Task> draining_;  // swapped with tasks_ so capacity is reused
+    mutable std::mutex mutex_;
+};
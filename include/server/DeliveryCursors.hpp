@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+/**
+ * Offline delivery state: for each signed-in user, the rooms they follow and, per room, the
+ * first seq they have not been sent yet
+ * Missed messages are read back from the room logs from there, so storage grows with
+ * users x rooms, never with the messages themselves. Each user has one small file in the
+ * directory (<user>.cursors), rewritten aside and renamed whenever a cursor moves; users are
+ * loaded on first use and cached. Thread-safe: each user has a lock of their own, so one
+ * user's file sync never holds up another's join or sign-in.
+ */
+class DeliveryCursors {
+public:
+    using RoomCursors = std::map<std::string, uint64_t>;  // room -> first seq not yet sent
+
+    bool open(const std::string& directory);  // creates the directory if missing
+
+    // Empty for a user who has never been recorded
+    RoomCursors get(const std::string& user);
+    // Records that `user` follows `room` and has been sent every message below next_seq;
+    // a cursor never moves back. False if the file could not be written.
+    bool advance(const std::string& user, const std::string& room, uint64_t next_seq);
+
+private:
+    struct User {
+        std::mutex mutex;  // guards the rest, and orders the user's file writes
+        bool loaded = false;
+        RoomCursors cursors;
+    };
+
+    std::string directory_;
+    std::map<std::string, std::shared_ptr<User>> users_;  // guarded by mutex_
+    std::mutex mutex_;
+
+    std::shared_ptr<User> find_user(const std::string& user);  // created on first use
+    void load(const std::string& user, User& entry) const;      // under entry.mutex, once
+    bool save(const std::string& user, const RoomCursors& cursors) const;
+    std::string path(const std::string& user) const;
+};
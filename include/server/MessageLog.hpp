@@ -0,0 +1,192 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include "storage/AppendFile.hpp"
+#include "storage/MappedFile.hpp"
+
+/**
+ * Durable, append-only message history for one channel
+ * Messages get consecutive sequence numbers starting at 1 and are stored as CRC-checked
+ * records in segment files of at most SEGMENT_BYTES, named after their first sequence
+ * number. append() only encodes into a memory buffer and returns; a writer thread writes
+ * whatever accumulated while the previous write was in flight and fsyncs once per batch
+ * (group commit). Readers see durable records through read-only mappings, so history is
+ * served straight out of the OS page cache without copying. Every SPARSE_EVERY-th record's
+ * offset and timestamp are indexed in memory, so a lookup by seq or by time is a binary
+ * search plus a scan of at most SPARSE_EVERY records.
+ *
+ * When a segment fills up, its index is checkpointed next to it. Reopening restores sealed
+ * segments from their checkpoints and only verifies (CRC-scans) segments without one,
+ * normally just the last, on parallel threads.
+ *
+ * History is bounded by maintenance calls from a background thread: enforce_retention()
+ * deletes whole sealed segments, oldest first, and compact() rewrites a sealed segment
+ * without the bodies of tombstoned (erased) messages. A compacted segment is written as
+ * <base>.cmp beside the original <base>.log, and the smaller of the two wins on reopen.
+ */
+class MessageLog {
+public:
+    // Keeps its segment's mapping alive while the views are in use
+    struct Entry {
+        uint64_t seq;
+        int64_t timestamp_ms;
+        std::string_view sender;
+        std::string_view text;
+        std::shared_ptr<const MappedFile> mapping;
+        bool deleted;  // erased: sender and text are empty
+    };
+
+    // Limits for enforce_retention(); 0 means unlimited
+    struct RetentionPolicy {
+        int64_t max_age_ms = 0;
+        uint64_t max_bytes = 0;   // segment files, not counting the active one
+        uint64_t max_count = 0;   // at least this many of the newest messages are kept
+    };
+
+    MessageLog();
+    ~MessageLog();
+
+    MessageLog(const MessageLog&) = delete;
+    MessageLog& operator=(const MessageLog&) = delete;
+
+    // Creates or reopens the log in `directory`; a torn tail from a crash is dropped. Segments
+    // that had to be scanned are checkpointed then, so the next open skips them.
+    bool open(const std::string& directory);
+    void close();  // writes and syncs everything appended so far
+    bool is_open() const;
+
+    // Returns the message's sequence number, or 0 if the log is not open or a write has
+    // failed (nothing is persisted from then on). Never waits for the disk unless
+    // MAX_PENDING_BYTES are already queued (then the caller is throttled).
+    uint64_t append(std::string_view sender, std::string_view text, int64_t timestamp_ms);
+
+    uint64_t first_seq() const;    // oldest stored message
+    uint64_t durable_seq() const;  // messages below this are synced and readable
+    uint64_t next_seq() const;     // what the next append() will return; 0 if not open
+    // Blocks until message `seq` is durable or the timeout passes; true if it is durable
+    bool wait_durable(uint64_t seq, std::chrono::milliseconds timeout);
+
+    // Appends up to max_count durable messages with seq >= from_seq; returns how many
+    size_t read(uint64_t from_seq, size_t max_count, std::vector<Entry>& out);
+
+    // First durable seq whose timestamp, or any earlier message's, is >= timestamp_ms (so a
+    // server clock stepping back cannot hide later messages); durable_seq() if there is none
+    uint64_t seq_at_time(int64_t timestamp_ms);
+
+    // Tombstones a stored message: reads return it as deleted from now on, and compact()
+    // reclaims its bytes once its segment is sealed. False if seq is not stored.
+    bool erase(uint64_t seq);
+
+    // Maintenance, from one thread at a time
+    // Deletes the oldest sealed segments while they are entirely past a limit of `policy`;
+    // the active segment is always kept. Returns how many were deleted.
+    size_t enforce_retention(const RetentionPolicy& policy, int64_t now_ms);
+    // Rewrites the oldest sealed segment holding tombstoned messages without their sender and
+    // text, working through at most bytes_per_second of it (0 = unthrottled). Returns the
+    // bytes reclaimed.
+    uint64_t compact(uint64_t bytes_per_second);
+
+    // Read-only pass over a log directory, e.g. by an offline tool while a server has it open:
+    // nothing is recovered, truncated or checkpointed. Calls `visit` with every intact record
+    // in seq order (erased ones with `deleted` set) and stops at the first damaged record or
+    // gap in the sequence. False if the directory cannot be read or `visit` returns false.
+    static bool scan(const std::string& directory, const std::function<bool(const Entry&)>& visit);
+
+    static constexpr uint64_t SEGMENT_BYTES = 64ull * 1024 * 1024;
+    static constexpr uint64_t SPARSE_EVERY = 64;
+    static constexpr size_t MAX_PENDING_BYTES = 64 * 1024 * 1024;
+    static constexpr size_t MAX_SENDER_SIZE = 0xFFFF;
+
+private:
+    struct Segment {
+        uint64_t base_seq;
+        uint64_t end_seq;   // records [base_seq, end_seq) are durable
+        uint64_t size;      // bytes up to the end of record end_seq - 1
+        std::string path;
+        std::vector<uint64_t> sparse;  // sparse[k] = offset of record base_seq + k * SPARSE_EVERY
+        std::vector<int64_t> sparse_time;  // newest timestamp up to and including that record
+        int64_t max_time;                  // newest timestamp up to end_seq
+        // Replaced rather than remapped when it falls behind, so handed-out views stay valid
+        std::shared_ptr<const MappedFile> mapping;
+    };
+
+    std::string directory_;
+
+    // Published segments, guarded by segments_mutex_
+    std::vector<std::shared_ptr<Segment>> segments_;
+    mutable std::mutex segments_mutex_;
+    std::condition_variable durable_cv_;  // signalled on every publish()
+
+    // Encoded records waiting for the writer, guarded by pending_mutex_
+    std::string pending_;
+    uint64_t next_seq_;
+    bool open_;
+    bool stopping_;
+    mutable std::mutex pending_mutex_;
+    std::condition_variable pending_cv_;  // writer: work arrived
+    std::condition_variable space_cv_;    // appenders: the writer took the queue
+
+    // Writer thread state
+    std::thread writer_;
+    AppendFile active_file_;
+    std::shared_ptr<Segment> active_;
+    uint64_t write_seq_;                // next record to be written
+    std::vector<uint64_t> new_sparse_;  // active_ entries written but not yet published
+    std::vector<int64_t> new_sparse_time_;
+    int64_t max_time_;                  // newest timestamp written so far
+    bool write_failed_;                 // set by the writer under pending_mutex_
+
+    std::atomic<uint64_t> durable_seq_;
+
+    // Erased seqs not yet compacted away, guarded by segments_mutex_. They are persisted in
+    // TOMBSTONE_FILE, guarded by tombstone_mutex_ (taken before segments_mutex_).
+    std::set<uint64_t> tombstones_;
+    AppendFile tombstone_file_;
+    std::mutex tombstone_mutex_;
+
+    // Maintenance thread state: files of deleted or replaced segments that could not be
+    // removed yet (Windows refuses while a reader still maps them), retried on the next call
+    std::vector<std::string> expired_files_;  // oldest first; removed in order so no gap opens
+    std::vector<std::string> replaced_files_;
+
+    // Internal methods
+    bool recover();
+    bool load_tombstones();
+    bool rewrite_tombstones();
+    void remove_leftover_files();
+    bool scan_segment(Segment& segment, bool& torn);
+    bool load_checkpoint(Segment& segment) const;
+    bool write_checkpoint(const Segment& segment) const;
+    bool start_segment(uint64_t base_seq);
+    void writer_loop();
+    bool write_batch(const std::string& batch);
+    void publish();
+    std::string segment_path(uint64_t base_seq, const char* extension = ".log") const;
+
+    static constexpr char MAGIC[8] = {'C', 'H', 'A', 'T', 'L', 'G', '0', '1'};
+    // Record flags
+    static constexpr uint16_t FLAG_DELETED = 1;  // compacted tombstone: no sender or text
+    // Tombstones: u64 seq, u32 CRC-32C of it, appended and synced per erase()
+    static constexpr char TOMBSTONE_FILE[] = "tombstones";
+    static constexpr size_t TOMBSTONE_SIZE = 12;
+    // Compaction writes in chunks of this size and sleeps between them to hold its rate
+    static constexpr size_t COMPACT_CHUNK = 1024 * 1024;
+    // Checkpoint (<base>.idx): magic, u64 base_seq, end_seq, size, i64 max_time, u64 count,
+    // count x (u64 offset, i64 time), then u32 CRC-32C of everything before it
+    static constexpr char CHECKPOINT_MAGIC[8] = {'C', 'H', 'A', 'T', 'I', 'X', '0', '1'};
+    // Record: u32 CRC-32C of the rest, u32 body size, u64 seq, i64 timestamp,
+    // u16 sender size, u16 flags, u32 reserved, then sender bytes and text bytes
+    static constexpr size_t RECORD_HEADER_SIZE = 32;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include "networking/MessageBuffer.hpp"
+
+/**
+ * The most recent frames sent to a room, replayed to clients when they join
+ * Slots hold views into the same pooled buffers the fan-out sent, so keeping them costs no
+ * copy; at most `capacity` frames totalling `max_bytes` are kept, oldest dropped first.
+ * Frames are pushed in sequence order (MessageView::seq) and can be looked up by range.
+ * Not thread-safe: guarded by the owning room's lock.
+ */
+class RecentRing {
+public:
+    explicit RecentRing(size_t capacity = DEFAULT_CAPACITY, size_t max_bytes = DEFAULT_MAX_BYTES);
+
+    void push(const MessageView& frame);
+    void clear();
+    // Swaps the frame with frame.seq for `frame` (an erased message's placeholder); no-op if
+    // that seq is no longer held
+    void replace(const MessageView& frame);
+
+    size_t size() const;
+    size_t bytes() const;
+    uint64_t first_seq() const;  // oldest frame's seq, 0 when empty
+
+    // Oldest first, with frames that are adjacent in one buffer merged into a single span
+    void spans(std::vector<std::string_view>& out) const;
+    // Copies of the frames with first_seq <= seq <= last_seq, which keep their buffers alive
+    void frames(uint64_t first_seq, uint64_t last_seq, std::vector<MessageView>& out) const;
+
+    static constexpr size_t DEFAULT_CAPACITY = 200;
+    static constexpr size_t DEFAULT_MAX_BYTES = 256 * 1024;
+
+private:
+    std::vector<MessageView> slots_;
+    size_t head_;   // oldest frame
+    size_t count_;
+    size_t bytes_;
+    size_t max_bytes_;
+
+    // Internal methods
+    void pop_oldest();
+};
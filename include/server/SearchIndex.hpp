@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+class MessageLog;
+
+/**
+ * Full-text index over one room's MessageLog
+ * Terms are runs of letters/digits (ASCII case-folded; UTF-8 sequences kept as-is) taken from
+ * the sender and the text, as in the GUI's ChatSearchIndex. An indexer thread follows the
+ * log's durable records, so appending never waits for indexing.
+ *
+ * New postings collect in a small in-memory table that is sealed every SEAL_EVERY messages
+ * into an immutable segment covering exactly that seq range: a sorted term dictionary and
+ * delta+varint coded postings. Runs of MERGE_FANIN segments of one level are merged into a
+ * single segment of the next level on the indexer thread, up to MAX_LEVEL. A search walks the
+ * segments newest first and stops once its page is full.
+ *
+ * Given a directory, every sealed or merged segment is also checkpointed there, and reopening
+ * loads the checkpoints instead of re-indexing the log: only messages past the last one are
+ * indexed again. Segments whose messages the log's retention has deleted are dropped, along
+ * with their checkpoints.
+ */
+class SearchIndex {
+public:
+    SearchIndex();
+    ~SearchIndex();
+
+    SearchIndex(const SearchIndex&) = delete;
+    SearchIndex& operator=(const SearchIndex&) = delete;
+
+    // Indexes everything `log` holds, then follows it until close(); close the index before the
+    // log. Checkpoints go to `directory` unless it is empty.
+    bool open(MessageLog& log, const std::string& directory = {});
+    void close();
+
+    uint64_t indexed_seq() const;  // messages below this are searchable
+    size_t segment_count() const;
+
+    // Appends, newest first, up to max_count seqs below before_seq (0 = no bound) of messages
+    // containing every query term. The last term also matches as a prefix unless the query
+    // ends in a separator. Returns false if the query has no terms.
+    bool search(std::string_view query, uint64_t before_seq, size_t max_count, std::vector<uint64_t>& out);
+
+    static constexpr uint64_t SEAL_EVERY = 4096;
+    static constexpr size_t MERGE_FANIN = 8;
+    // Segments stop growing at 4096 * 8^2 = 256K messages, which bounds the postings a search
+    // decodes per segment before it can stop
+    static constexpr uint32_t MAX_LEVEL = 2;
+    static constexpr size_t MAX_TERM_LENGTH = 32;
+    // Prefix matches merge at most this many terms so one-letter queries stay cheap
+    static constexpr size_t MAX_PREFIX_TERMS = 256;
+
+private:
+    // Immutable once published; searches keep the ones they walk alive
+    struct Segment {
+        uint64_t base_seq;
+        uint64_t end_seq;  // covers [base_seq, end_seq)
+        uint32_t level;
+        std::vector<std::string> terms;  // sorted
+        std::vector<uint64_t> offsets;   // terms[i]'s postings are postings[offsets[i], offsets[i + 1])
+        std::string postings;            // varint seq - base_seq, then varint gaps
+    };
+
+    MessageLog* log_;
+    std::string directory_;
+    std::thread indexer_;
+    std::atomic<bool> stopping_;
+
+    // Guarded by mutex_
+    std::vector<std::shared_ptr<const Segment>> segments_;  // ascending, contiguous seq ranges
+    std::map<std::string, std::vector<uint64_t>, std::less<>> recent_;  // postings since recent_base_
+    uint64_t recent_base_;
+    mutable std::mutex mutex_;
+
+    std::atomic<uint64_t> indexed_seq_;
+
+    // Internal methods
+    void indexer_loop();
+    void load_checkpoints();
+    void drop_expired();
+    void seal();
+    void merge_tail();
+    void write_checkpoint(const Segment& segment) const;
+    static std::shared_ptr<const Segment> read_checkpoint(const std::string& path);
+    std::string checkpoint_path(uint64_t base_seq, uint64_t end_seq) const;
+    static std::shared_ptr<const Segment> merge(const std::vector<std::shared_ptr<const Segment>>& inputs);
+    static void decode(const Segment& segment, size_t term, std::vector<uint64_t>& out);
+    void match_recent(const std::vector<std::string_view>& terms, bool prefix_last, std::vector<uint64_t>& out) const;
+    static void match_segment(const Segment& segment, const std::vector<std::string_view>& terms, bool prefix_last,
+                              std::vector<uint64_t>& out);
+
+    static constexpr size_t READ_BATCH = 1024;
+    // Checkpoint (<base>-<end>.idx): magic, u64 base_seq, end_seq, u32 level, term count, each
+    // term as u8 length + bytes, u64 offsets (count + 1), postings, then u32 CRC-32C
+    static constexpr char CHECKPOINT_MAGIC[8] = {'C', 'H', 'A', 'T', 'S', 'X', '0', '1'};
+    // How long the indexer waits for new messages before checking for close()
+    static constexpr std::chrono::milliseconds WAIT_INTERVAL{100};
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Append-only file handle with explicit durability
+ * Writes go straight to the OS with no user-space buffering, so a MappedFile of the same
+ * path sees them immediately; sync() makes them durable. Win32 handles on Windows, POSIX
+ * file descriptors elsewhere.
+ */
+class AppendFile {
+public:
+    AppendFile();
+    ~AppendFile();
+
+    AppendFile(const AppendFile&) = delete;
+    AppendFile& operator=(const AppendFile&) = delete;
+
+    // Creates the file if missing; writes always land at the end
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const;
+
+    bool append(const void* data, size_t size);
+    bool sync();                   // flush to stable storage (fsync / FlushFileBuffers)
+    bool truncate(uint64_t size);  // e.g. drop a torn tail; not while the region is mapped on Windows
+    uint64_t size() const;
+
+private:
+#ifdef _WIN32
+    void* handle_;  // HANDLE
+#else
+    int fd_;
+#endif
+    uint64_t size_;
+};
+
+// Replaces the file at `path` with `data`: written to <path>.tmp, synced, renamed over `path`
+// and the rename made durable, so a crash leaves either the old contents or the new ones.
+// False (with the temporary removed) if any step failed.
+bool write_file_atomically(const std::string& path, const void* data, size_t size);
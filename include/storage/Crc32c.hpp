@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32C (Castagnoli polynomial, as in iSCSI and ext4). Pass a previous result as `crc`
+// to continue a running checksum over several buffers. Uses the SSE4.2 crc32 instruction
+// (three interleaved streams joined with PCLMULQDQ) when the CPU has it, else the table
+// implementation below; both give identical results.
+uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+// Portable slicing-by-8 implementation, exposed for benchmarks and cross-checks
+uint32_t crc32c_portable(const void* data, size_t size, uint32_t crc = 0);
+
+// Name of the implementation crc32c() dispatches to, e.g. "sse4.2+pclmul"
+const char* crc32c_implementation();
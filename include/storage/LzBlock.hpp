@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// LZ77 block compression in the LZ4 block layout: each sequence is a token (literal count
+// and match length nibbles, extended by 255-runs), the literals, and a 16-bit back-reference
+// of at least LZ_MIN_MATCH bytes; the last sequence has literals only. Greedy single-probe
+// matching keeps compression fast, and decompression is a bounds-checked copy loop.
+
+// Appends the compressed form of `data` to `out`
+void lz_compress(const void* data, size_t size, std::string& out);
+
+// Appends exactly `decompressed_size` bytes decoded from a block lz_compress() produced;
+// false (with `out` possibly extended) if the block is damaged or decodes to another size
+bool lz_decompress(const void* data, size_t size, size_t decompressed_size, std::string& out);
+
+constexpr size_t LZ_MIN_MATCH = 4;
+constexpr size_t LZ_MAX_OFFSET = 0xFFFF;
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Read-only memory mapping of a whole file
+ * The mapping covers the file size at open()/remap() time; call remap() to see data
+ * appended since. Other handles may keep writing to the file while it is mapped.
+ */
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    bool remap();
+    void close();
+    bool is_open() const;
+
+    // nullptr while the mapped size is 0
+    const char* data() const;
+    size_t size() const;
+
+private:
+    std::string path_;
+#ifdef _WIN32
+    void* file_;     // HANDLE
+    void* mapping_;  // HANDLE
+#else
+    int fd_;
+#endif
+    const char* data_;
+    size_t size_;
+
+    // Internal methods
+    bool map();
+    void unmap();
+};
@@ -0,0 +1,367 @@
+#include "analytics/ColumnFile.hpp"
+#include "storage/Crc32c.hpp"
+#include "storage/LzBlock.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+static constexpr char MAGIC[8] = {'C', 'H', 'A', 'T', 'C', 'O', 'L', '1'};
+static constexpr size_t TRAILER_SIZE = 4 + 8 + sizeof(MAGIC);  // footer CRC, footer size, magic
+
+// Chunk indices within a group
+static constexpr size_t SEQ = 0;
+static constexpr size_t TIME = 1;
+static constexpr size_t SENDER = 2;
+static constexpr size_t LENGTH = 3;
+static constexpr size_t TEXT = 4;
+
+static void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+static bool get_varint(const unsigned char*& pos, const unsigned char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+        const unsigned char byte = *pos++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// Small negative and positive deltas both take few bytes; arithmetic wraps so any pair of
+// timestamps round-trips
+static uint64_t zigzag(uint64_t delta) {
+    return (delta << 1) ^ (uint64_t)((int64_t)delta >> 63);
+}
+
+static uint64_t unzigzag(uint64_t value) {
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+static void put_u32(std::string& out, uint32_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+ColumnFileWriter::ColumnFileWriter() : failed_(false), last_seq_(0), last_ms_(0) {
+}
+
+ColumnFileWriter::~ColumnFileWriter() {
+    if (file_.is_open()) {
+        file_.close();
+        std::error_code error;
+        std::filesystem::remove(path_ + ".tmp", error);
+    }
+}
+
+bool ColumnFileWriter::open(const std::string& path) {
+    path_ = path;
+    failed_ = false;
+    rooms_.clear();
+    senders_.clear();
+    room_ids_.clear();
+    sender_ids_.clear();
+    groups_.clear();
+    group_ = ColumnGroup();
+    for (std::string& column : columns_) column.clear();
+
+    if (!file_.open(path + ".tmp") || !file_.truncate(0) || !file_.append(MAGIC, sizeof(MAGIC))) {
+        std::cerr << "[ColumnFile] Cannot create " << path << ".tmp\n";
+        file_.close();
+        failed_ = true;
+        return false;
+    }
+    return true;
+}
+
+bool ColumnFileWriter::add(std::string_view room, uint64_t seq, int64_t timestamp_ms, std::string_view sender,
+                           std::string_view text) {
+    if (!file_.is_open() || failed_) return false;
+
+    const uint32_t room_id = intern(room, rooms_, room_ids_);
+    if (group_.rows > 0 && (room_id != group_.room || seq <= last_seq_ || group_.rows >= ROWS_PER_GROUP ||
+                            columns_[TEXT].size() + text.size() > TEXT_BYTES_PER_GROUP)) {
+        if (!flush_group()) return false;
+    }
+    if (group_.rows == 0) {
+        group_.room = room_id;
+        group_.first_seq = seq;
+        group_.first_ms = timestamp_ms;
+        group_.min_ms = timestamp_ms;
+        group_.max_ms = timestamp_ms;
+        last_seq_ = seq;
+        last_ms_ = timestamp_ms;
+    }
+
+    put_varint(columns_[SEQ], seq - last_seq_);
+    put_varint(columns_[TIME], zigzag((uint64_t)timestamp_ms - (uint64_t)last_ms_));
+    put_varint(columns_[SENDER], intern(sender, senders_, sender_ids_));
+    put_varint(columns_[LENGTH], text.size());
+    columns_[TEXT].append(text);
+    group_.min_ms = std::min(group_.min_ms, timestamp_ms);
+    group_.max_ms = std::max(group_.max_ms, timestamp_ms);
+    last_seq_ = seq;
+    last_ms_ = timestamp_ms;
+    ++group_.rows;
+    return true;
+}
+
+bool ColumnFileWriter::close() {
+    if (!file_.is_open()) return false;
+    bool written = !failed_ && flush_group();
+
+    std::string footer;
+    put_varint(footer, rooms_.size());
+    for (const std::string& room : rooms_) {
+        put_varint(footer, room.size());
+        footer += room;
+    }
+    put_varint(footer, senders_.size());
+    for (const std::string& sender : senders_) {
+        put_varint(footer, sender.size());
+        footer += sender;
+    }
+    put_varint(footer, groups_.size());
+    for (const ColumnGroup& group : groups_) {
+        put_varint(footer, group.room);
+        put_varint(footer, group.rows);
+        put_varint(footer, group.first_seq);
+        put_varint(footer, zigzag((uint64_t)group.first_ms));
+        put_varint(footer, zigzag((uint64_t)group.min_ms));
+        put_varint(footer, zigzag((uint64_t)group.max_ms));
+        for (const ColumnChunk& chunk : group.chunks) {
+            put_varint(footer, chunk.offset);
+            put_varint(footer, chunk.size);
+            put_varint(footer, chunk.decoded_size);
+            put_u32(footer, chunk.crc);
+        }
+    }
+    const uint64_t footer_size = footer.size();
+    put_u32(footer, crc32c(footer.data(), footer.size()));
+    footer.append(reinterpret_cast<const char*>(&footer_size), sizeof(footer_size));
+    footer.append(MAGIC, sizeof(MAGIC));
+
+    written = written && file_.append(footer.data(), footer.size()) && file_.sync();
+    file_.close();
+    const std::string temp = path_ + ".tmp";
+    std::error_code error;
+    if (written) {
+        std::filesystem::rename(temp, path_, error);
+    }
+    if (!written || error) {
+        std::cerr << "[ColumnFile] Cannot write " << path_ << "\n";
+        std::filesystem::remove(temp, error);
+        return false;
+    }
+    return true;
+}
+
+bool ColumnFileWriter::flush_group() {
+    if (group_.rows == 0) return true;
+    for (size_t k = 0; k < COLUMN_COUNT; ++k) {
+        group_.chunks[k].decoded_size = columns_[k].size();
+        if (k == TEXT) {
+            compressed_.clear();
+            lz_compress(columns_[k].data(), columns_[k].size(), compressed_);
+        }
+        if (!write(k == TEXT ? compressed_ : columns_[k], group_.chunks[k])) return false;
+        columns_[k].clear();
+    }
+    groups_.push_back(group_);
+    group_ = ColumnGroup();
+    return true;
+}
+
+bool ColumnFileWriter::write(const std::string& data, ColumnChunk& chunk) {
+    chunk.offset = file_.size();
+    chunk.size = data.size();
+    chunk.crc = crc32c(data.data(), data.size());
+    if (!file_.append(data.data(), data.size())) {
+        std::cerr << "[ColumnFile] Write to " << path_ << ".tmp failed\n";
+        failed_ = true;
+        return false;
+    }
+    return true;
+}
+
+uint32_t ColumnFileWriter::intern(std::string_view name, std::vector<std::string>& names,
+                                  std::unordered_map<std::string, uint32_t>& ids) {
+    auto result = ids.emplace(std::string(name), (uint32_t)names.size());
+    if (result.second) names.emplace_back(name);
+    return result.first->second;
+}
+
+bool ColumnFileReader::open(const std::string& path) {
+    close();
+    path_ = path;
+    bool valid = file_.open(path) && file_.size() >= sizeof(MAGIC) + TRAILER_SIZE;
+    const unsigned char* data = (const unsigned char*)file_.data();
+    const uint64_t size = file_.size();
+    if (valid) {
+        valid = std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0 &&
+                std::memcmp(data + size - sizeof(MAGIC), MAGIC, sizeof(MAGIC)) == 0;
+    }
+    uint64_t footer_size = 0;
+    if (valid) {
+        std::memcpy(&footer_size, data + size - sizeof(MAGIC) - 8, sizeof(footer_size));
+        valid = footer_size <= size - sizeof(MAGIC) - TRAILER_SIZE;
+    }
+    if (valid) {
+        const uint64_t footer_start = size - TRAILER_SIZE - footer_size;
+        uint32_t crc;
+        std::memcpy(&crc, data + size - TRAILER_SIZE, sizeof(crc));
+        valid = crc32c(data + footer_start, footer_size) == crc &&
+                parse_footer(data + footer_start, data + footer_start + footer_size, footer_start);
+    }
+    if (!valid) {
+        std::cerr << "[ColumnFile] " << path << " is not a complete column file\n";
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ColumnFileReader::close() {
+    file_.close();
+    rooms_.clear();
+    senders_.clear();
+    groups_.clear();
+    rows_ = 0;
+}
+
+const std::vector<std::string>& ColumnFileReader::rooms() const {
+    return rooms_;
+}
+
+const std::vector<std::string>& ColumnFileReader::senders() const {
+    return senders_;
+}
+
+const std::vector<ColumnGroup>& ColumnFileReader::groups() const {
+    return groups_;
+}
+
+uint64_t ColumnFileReader::row_count() const {
+    return rows_;
+}
+
+bool ColumnFileReader::parse_footer(const unsigned char* pos, const unsigned char* end, uint64_t data_end) {
+    auto read_names = [&pos, end](std::vector<std::string>& names) {
+        uint64_t count;
+        if (!get_varint(pos, end, count) || count > (uint64_t)(end - pos)) return false;
+        names.reserve((size_t)count);
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t length;
+            if (!get_varint(pos, end, length) || length > (uint64_t)(end - pos)) return false;
+            names.emplace_back(reinterpret_cast<const char*>(pos), (size_t)length);
+            pos += length;
+        }
+        return true;
+    };
+    if (!read_names(rooms_) || !read_names(senders_)) return false;
+
+    uint64_t count;
+    if (!get_varint(pos, end, count) || count > (uint64_t)(end - pos)) return false;
+    groups_.resize((size_t)count);
+    for (ColumnGroup& group : groups_) {
+        uint64_t room;
+        uint64_t first_ms;
+        uint64_t min_ms;
+        uint64_t max_ms;
+        if (!get_varint(pos, end, room) || !get_varint(pos, end, group.rows) ||
+            !get_varint(pos, end, group.first_seq) || !get_varint(pos, end, first_ms) ||
+            !get_varint(pos, end, min_ms) || !get_varint(pos, end, max_ms) || room >= rooms_.size()) {
+            return false;
+        }
+        group.room = (uint32_t)room;
+        group.first_ms = (int64_t)unzigzag(first_ms);
+        group.min_ms = (int64_t)unzigzag(min_ms);
+        group.max_ms = (int64_t)unzigzag(max_ms);
+        for (ColumnChunk& chunk : group.chunks) {
+            if (!get_varint(pos, end, chunk.offset) || !get_varint(pos, end, chunk.size) ||
+                !get_varint(pos, end, chunk.decoded_size) || end - pos < 4) {
+                return false;
+            }
+            std::memcpy(&chunk.crc, pos, sizeof(chunk.crc));
+            pos += 4;
+            if (chunk.offset < sizeof(MAGIC) || chunk.offset > data_end || chunk.size > data_end - chunk.offset) {
+                return false;
+            }
+        }
+        rows_ += group.rows;
+    }
+    return pos == end;
+}
+
+bool ColumnFileReader::read(size_t index, unsigned columns, ColumnBatch& out) const {
+    out.seq.clear();
+    out.timestamp_ms.clear();
+    out.sender.clear();
+    out.length.clear();
+    out.text.clear();
+    if (index >= groups_.size()) return false;
+
+    const ColumnGroup& group = groups_[index];
+    out.room = group.room;
+    const unsigned char* data = (const unsigned char*)file_.data();
+    for (size_t k = 0; k < COLUMN_COUNT; ++k) {
+        if (!(columns & (1u << k))) continue;
+        const ColumnChunk& chunk = group.chunks[k];
+        const unsigned char* pos = data + chunk.offset;
+        const unsigned char* end = pos + chunk.size;
+        bool valid = crc32c(pos, chunk.size) == chunk.crc;
+
+        uint64_t value;
+        if (valid && k == SEQ) {
+            out.seq.reserve((size_t)group.rows);
+            uint64_t seq = group.first_seq;
+            for (uint64_t row = 0; valid && row < group.rows; ++row) {
+                valid = get_varint(pos, end, value);
+                seq += value;
+                out.seq.push_back(seq);
+            }
+        } else if (valid && k == TIME) {
+            out.timestamp_ms.reserve((size_t)group.rows);
+            uint64_t timestamp_ms = (uint64_t)group.first_ms;
+            for (uint64_t row = 0; valid && row < group.rows; ++row) {
+                valid = get_varint(pos, end, value);
+                timestamp_ms += unzigzag(value);
+                out.timestamp_ms.push_back((int64_t)timestamp_ms);
+            }
+        } else if (valid && (k == SENDER || k == LENGTH)) {
+            std::vector<uint32_t>& column = k == SENDER ? out.sender : out.length;
+            column.reserve((size_t)group.rows);
+            for (uint64_t row = 0; valid && row < group.rows; ++row) {
+                valid = get_varint(pos, end, value) && value <= UINT32_MAX && (k != SENDER || value < senders_.size());
+                column.push_back((uint32_t)value);
+            }
+        } else if (valid && k == TEXT) {
+            valid = lz_decompress(pos, chunk.size, (size_t)chunk.decoded_size, out.text);
+            pos = end;
+        }
+
+        if (!valid || pos != end) {
+            std::cerr << "[ColumnFile] Column " << k << " of row group " << index << " in " << path_
+                      << " is damaged\n";
+            return false;
+        }
+    }
+
+    // Each chunk can pass its CRC and still disagree with the other; readers slice the text
+    // by the lengths, so a mismatch would read past the end or misattribute messages
+    if ((columns & COLUMN_LENGTH) && (columns & COLUMN_TEXT)) {
+        uint64_t total = 0;
+        for (uint32_t length : out.length) total += length;
+        if (total != out.text.size()) {
+            std::cerr << "[ColumnFile] Lengths of row group " << index << " in " << path_ << " add up to "
+                      << total << " bytes but its text has " << out.text.size() << "\n";
+            return false;
+        }
+    }
+    return true;
+}
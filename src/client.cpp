@@ -1,9 +1,18 @@
 #include "networking/ChatClient.hpp"
 #include <iostream>
-#include <thread>
 
-int main() {
+int main(int argc, char** argv) {
     ChatClient client;
+    // Optional user name: messages sent to the user's rooms while offline arrive on connect
+    if (argc > 1) {
+        client.set_user(argv[1]);
+    }
+
+    // Print messages as soon as they arrive, straight from the network thread
+    client.on_message([](const MessageView& msg) {
+        std::cout << "[" << (msg.sender.empty() ? std::string_view("remote") : msg.sender) << "] " << msg.text
+                  << std::endl;
+    });
 
     std::cout << "Connecting to server...\n";
     if (!client.connect("127.0.0.1", 54000)) {
@@ -13,20 +22,6 @@ int main() {
 
     std::cout << "Connected! Type messages (Ctrl+C to exit):\n";
 
-    // Start receive display thread
-    std::atomic<bool> running(true);
-    std::thread display_thread([&client, &running]() {
-        while (running) {
-            if (client.has_pending_messages()) {
-                std::string msg = client.receive_message();
-                if (!msg.empty()) {
-                    std::cout << "[remote] " << msg;
-                }
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        }
-    });
-
     // Main input loop
     std::string line;
     while (std::getline(std::cin, line)) {
@@ -37,11 +32,6 @@ int main() {
         }
     }
 
-    running = false;
-    if (display_thread.joinable()) {
-        display_thread.join();
-    }
-
     client.disconnect();
     return 0;
 }
@@ -1,19 +1,45 @@
 #include "gui/ChatGui.hpp"
+#include "gui/FrameProfiler.hpp"
 #include "networking/ChatClient.hpp"
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include <GLFW/glfw3.h>
 #include <sstream>
+#include <algorithm>
+#include <chrono>
 #include <cstring>  // for memset
+#include <iostream>
 
 
 static GLFWwindow* g_window = nullptr;
 
 ChatGui::ChatGui()
-    : connected_(false), show_connection_status_(true), scroll_to_bottom_(0.0f) {
+    : search_end_(0), search_cursor_(NO_HIT), page_log_(2 * PAGE_ROWS), paging_(false), room_first_seq_(0),
+      room_first_row_(0), remote_log_(REMOTE_ROWS), remote_paging_(false), remote_pending_(false),
+      remote_exhausted_(false), remote_request_(0), last_scroll_y_(0.0f),
+      show_profiler_(false), last_rtt_poll_(0.0), backlog_(0), connected_(false),
+      last_state_(ConnectionState::Disconnected), show_connection_status_(true), scroll_to_bottom_(0.0f),
+      frames_to_draw_(FRAMES_AFTER_EVENT) {
     std::memset(input_buffer_, 0, sizeof(input_buffer_));
+    std::memset(search_buffer_, 0, sizeof(search_buffer_));
+    std::memset(user_buffer_, 0, sizeof(user_buffer_));
     client_ = std::make_unique<ChatClient>();
+
+    // Evicted messages leave the search index and go to disk while their text is still readable
+    chat_log_.on_evict([this](uint64_t index) {
+        std::string_view sender = chat_log_.sender(index);
+        std::string_view text = chat_log_.text(index);
+        search_index_.remove(index, sender, text);
+        if (scrollback_.is_open()) {
+            scrollback_.append(index, sender, text, chat_log_.entry(index).timestamp_ms);
+        }
+    });
+
+    // Connection state changes arrive on the network thread and are replayed here once per frame
+    ui_dispatcher_.attach(*client_, nullptr, [this](ConnectionState state, const std::string& detail) {
+        on_connection_state(state, detail);
+    });
 }
 
 ChatGui::~ChatGui() {
@@ -55,6 +81,10 @@ bool ChatGui::init(const std::string& title, int width, int height) {
 
     add_chat_message("System", "Welcome to Chat Client\nType your messages below and press Send");
 
+    // Network activity pulls the render loop out of glfwWaitEventsTimeout (thread-safe)
+    ui_dispatcher_.set_wake_handler([]() { glfwPostEmptyEvent(); });
+    client_->on_messages_pending([]() { glfwPostEmptyEvent(); });
+
     return true;
 }
 
@@ -63,6 +93,22 @@ void ChatGui::shutdown() {
         disconnect();
     }
 
+    // Messages still in memory go to disk too, so the next run's history pages include them
+    if (scrollback_.is_open()) {
+        for (uint64_t index = std::max(chat_log_.first_index(), scrollback_.end_index());
+             index < chat_log_.end_index(); ++index) {
+            scrollback_.append(index, chat_log_.sender(index), chat_log_.text(index),
+                               chat_log_.entry(index).timestamp_ms);
+        }
+        if (!scrollback_.flush()) {
+            std::cerr << "[ChatGui] Could not save chat history\n";
+        }
+    }
+
+    // No wakeups once GLFW is gone
+    ui_dispatcher_.set_wake_handler(nullptr);
+    client_->on_messages_pending(nullptr);
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -78,47 +124,83 @@ bool ChatGui::is_running() const {
 }
 
 void ChatGui::render() {
-    glfwPollEvents();
+    wait_for_events();
+#if CHAT_PROFILER
+    FrameProfiler::instance().begin_frame();
+#endif
 
     // Start ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
-    // Handle connection status and incoming messages
-    if (connected_) {
+    // Handle incoming messages, then connection status (so "[SYSTEM]" notices land first)
+    {
+        PROFILE_SCOPE(Drain);
         handle_incoming_messages();
+        ui_dispatcher_.drain();
+        scrollback_.flush();  // this frame's evictions reach the file in one write
     }
 
     // Render UI
-    render_menu_bar();
-    render_chat_window();
-    render_input_area();
+    {
+        PROFILE_SCOPE(Submit);
+        render_menu_bar();
+        render_chat_window();
+        render_input_area();
+        render_profiler();
+        ImGui::Render();
+    }
 
     // Rendering
-    ImGui::Render();
-    int display_w, display_h;
-    glfwGetFramebufferSize(g_window, &display_w, &display_h);
-    glViewport(0, 0, display_w, display_h);
-    glClearColor(0.45f, 0.55f, 0.60f, 1.00f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    {
+        PROFILE_SCOPE(Render);
+        int display_w, display_h;
+        glfwGetFramebufferSize(g_window, &display_w, &display_h);
+        glViewport(0, 0, display_w, display_h);
+        glClearColor(0.45f, 0.55f, 0.60f, 1.00f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    }
+#if CHAT_PROFILER
+    FrameProfiler::instance().end_frame();  // the vsync wait in SwapBuffers is not frame cost
+#endif
     glfwSwapBuffers(g_window);
 }
 
+void ChatGui::wait_for_events() {
+    // Something still in motion or queued: keep drawing at vsync rate
+    bool busy = frames_to_draw_ > 0 || scroll_to_bottom_ > 0.0f || client_->has_pending_messages() ||
+                !ui_dispatcher_.empty();
+    if (busy) {
+        glfwPollEvents();
+        if (frames_to_draw_ > 0) --frames_to_draw_;
+        return;
+    }
+
+    // Idle: block until input, a network wakeup (glfwPostEmptyEvent) or the timeout
+    const double started = glfwGetTime();
+    glfwWaitEventsTimeout(IDLE_TIMEOUT_SECONDS);
+    if (glfwGetTime() - started < IDLE_TIMEOUT_SECONDS) {
+        frames_to_draw_ = FRAMES_AFTER_EVENT;
+    }
+}
+
 void ChatGui::connect(const std::string& host, int port) {
     if (connected_) {
         add_chat_message("System", "Already connected");
         return;
     }
+    if (last_state_ == ConnectionState::Resolving || last_state_ == ConnectionState::Connecting) {
+        add_chat_message("System", "Connection already in progress");
+        return;
+    }
 
     add_chat_message("System", "Connecting to " + host + ":" + std::to_string(port) + "...");
 
-    if (client_->connect(host, port)) {
-        connected_ = true;
-        add_chat_message("System", "Connected!");
-    } else {
+    // Non-blocking: the outcome is reported to on_connection_state() on a later frame
+    if (!client_->connect_async(host, port)) {
         add_chat_message("System", "Connection failed");
     }
 }
@@ -128,6 +210,7 @@ void ChatGui::disconnect() {
 
     client_->disconnect();
     connected_ = false;
+    last_state_ = ConnectionState::Disconnected;
     add_chat_message("System", "Disconnected");
 }
 
@@ -135,11 +218,35 @@ bool ChatGui::is_connected() const {
     return connected_ && client_->is_connected();
 }
 
+void ChatGui::set_history_capacity(size_t lines) {
+    chat_log_.set_capacity(lines);
+}
+
+bool ChatGui::open_scrollback(const std::string& path) {
+    if (!chat_log_.empty()) {
+        std::cerr << "[ChatGui] open_scrollback() must be called before any message is added\n";
+        return false;
+    }
+    if (!scrollback_.open(path)) {
+        return false;
+    }
+
+    // Live indices continue where the stored history ends
+    chat_log_.reset(scrollback_.end_index());
+    search_end_ = chat_log_.end_index();
+    return true;
+}
+
 void ChatGui::render_menu_bar() {
     if (ImGui::BeginMainMenuBar()) {
         if (ImGui::BeginMenu("Connection")) {
-            if (!is_connected()) {
+            if (last_state_ == ConnectionState::Resolving || last_state_ == ConnectionState::Connecting) {
+                ImGui::MenuItem("Connecting...", nullptr, false, false);
+            } else if (!is_connected()) {
+                // Signed-in users get what was sent to their rooms while they were away
+                ImGui::InputTextWithHint("##user", "User name (optional)", user_buffer_, sizeof(user_buffer_));
                 if (ImGui::MenuItem("Connect (localhost:54000)")) {
+                    client_->set_user(user_buffer_);
                     connect("127.0.0.1", 54000);
                 }
             } else {
@@ -150,6 +257,13 @@ void ChatGui::render_menu_bar() {
             ImGui::EndMenu();
         }
 
+#if CHAT_PROFILER
+        if (ImGui::BeginMenu("View")) {
+            ImGui::MenuItem("Profiler", "F3", &show_profiler_);
+            ImGui::EndMenu();
+        }
+#endif
+
         if (ImGui::BeginMenu("Help")) {
             if (ImGui::MenuItem("About")) {
                 add_chat_message("System", "Chat Client v1.0 - C++17 with ImGui");
@@ -169,20 +283,316 @@ void ChatGui::render_chat_window() {
 
     ImGui::Begin("Chat Log", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize);
 
-    // Chat display
+    render_search_bar();
+
+    // Chat display: the live log, or a window of older history paged in from disk or the server
+    ChatLogView& view = remote_paging_ ? remote_view_ : paging_ ? page_view_ : chat_view_;
+    const ChatLog& log = remote_paging_ ? remote_log_ : paging_ ? page_log_ : chat_log_;
+    view.apply_scroll(log);  // before BeginChild, so jumps land this frame
+
     ImGui::BeginChild("chat_log", ImVec2(0, -30), false, ImGuiWindowFlags_HorizontalScrollbar);
-    for (const auto& line : chat_log_) {
-        ImGui::TextWrapped("%s", line.c_str());
-    }
-    if (scroll_to_bottom_ > 0.0f) {
+    // Virtualized, variable-height rows: only what intersects the viewport is submitted
+    view.draw(log);
+    if (!paging_ && !remote_paging_ && scroll_to_bottom_ > 0.0f) {
         ImGui::SetScrollHereY(1.0f);
         scroll_to_bottom_ -= ImGui::GetIO().DeltaTime;
     }
+    const bool hovered = ImGui::IsWindowHovered();
+    bool scrolled_up = ImGui::GetScrollY() < last_scroll_y_ || (hovered && ImGui::GetIO().MouseWheel > 0.0f);
+    bool pulled_past_bottom = ImGui::GetScrollY() >= ImGui::GetScrollMaxY() &&
+                              (ImGui::GetScrollY() > last_scroll_y_ || (hovered && ImGui::GetIO().MouseWheel < 0.0f));
+    last_scroll_y_ = ImGui::GetScrollY();
     ImGui::EndChild();
 
+    if (!remote_paging_) {
+        update_paging(scrolled_up);
+    }
+    update_remote_history(scrolled_up, pulled_past_bottom);
+
+    if (paging_ || remote_paging_) {
+        if (!remote_paging_) {
+            ImGui::TextDisabled("Viewing history");
+        } else if (remote_pending_) {
+            ImGui::TextDisabled("Loading history...");
+        } else {
+            ImGui::TextDisabled(remote_exhausted_ ? "Start of room history" : "Viewing room history");
+        }
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Jump to latest")) {
+            paging_ = false;
+            leave_remote_history();
+            scroll_to_bottom_ = 1.0f;
+        }
+        ImGui::SameLine();
+    }
+    if (backlog_ > 0) {
+        ImGui::TextColored(ImVec4(1, 1, 0, 1), "Catching up... (%zu messages queued)", backlog_);
+    }
+
     ImGui::End();
 }
 
+void ChatGui::render_search_bar() {
+    ImGui::PushItemWidth(-170);
+    bool changed = ImGui::InputTextWithHint("##search", "Search history", search_buffer_, sizeof(search_buffer_));
+    bool enter = ImGui::IsItemFocused() && ImGui::IsKeyPressed(ImGuiKey_Enter);
+    ImGui::PopItemWidth();
+
+    if (changed) {
+        update_search(true);
+    } else if (search_buffer_[0] != '\0') {
+        update_search(false);  // only messages appended since last frame are searched
+    }
+
+    ImGui::SameLine();
+    if (search_buffer_[0] == '\0') {
+        ImGui::TextDisabled("       ");
+    } else if (search_hits_.empty()) {
+        ImGui::TextDisabled("No matches");
+    } else if (search_cursor_ == NO_HIT) {
+        ImGui::Text("%zu hits", search_hits_.size());
+    } else {
+        ImGui::Text("%zu / %zu", search_cursor_ + 1, search_hits_.size());
+    }
+
+    // Up = older hit (also Enter in the search box), Down = newer hit
+    ImGui::SameLine();
+    if ((ImGui::ArrowButton("##search_prev", ImGuiDir_Up) || enter) && !search_hits_.empty()) {
+        select_hit(search_cursor_ == NO_HIT ? search_hits_.size() - 1 : (search_cursor_ > 0 ? search_cursor_ - 1 : 0));
+    }
+    ImGui::SameLine();
+    if (ImGui::ArrowButton("##search_next", ImGuiDir_Down) && search_cursor_ != NO_HIT &&
+        search_cursor_ + 1 < search_hits_.size()) {
+        select_hit(search_cursor_ + 1);
+    }
+}
+
+void ChatGui::update_search(bool query_changed) {
+    if (query_changed) {
+        search_hits_.clear();
+        search_end_ = chat_log_.first_index();
+        search_cursor_ = NO_HIT;
+        chat_view_.set_highlight(ChatLogView::NO_ROW);
+    }
+
+    // Drop hits whose messages have been evicted
+    auto live = std::lower_bound(search_hits_.begin(), search_hits_.end(), chat_log_.first_index());
+    size_t dropped = (size_t)(live - search_hits_.begin());
+    if (dropped > 0) {
+        search_hits_.erase(search_hits_.begin(), live);
+        if (search_cursor_ != NO_HIT) {
+            search_cursor_ = search_cursor_ >= dropped ? search_cursor_ - dropped : NO_HIT;
+        }
+    }
+
+    if (search_end_ < chat_log_.end_index()) {
+        search_index_.search(search_buffer_, search_hits_, search_end_);
+        search_end_ = chat_log_.end_index();
+    }
+
+    if (query_changed) {
+        if (!search_hits_.empty()) {
+            select_hit(search_hits_.size() - 1);  // newest match first
+        } else if (search_buffer_[0] == '\0') {
+            scroll_to_bottom_ = 1.0f;  // search cleared: back to following the tail
+        }
+    }
+}
+
+void ChatGui::select_hit(size_t hit) {
+    paging_ = false;  // hits are in the live log
+    leave_remote_history();
+    search_cursor_ = hit;
+    chat_view_.set_highlight(search_hits_[hit]);
+    chat_view_.scroll_to(search_hits_[hit]);
+    scroll_to_bottom_ = 0.0f;
+}
+
+void ChatGui::update_paging(bool scrolled_up) {
+    if (scrollback_.end_index() == 0) return;
+
+    ChatLogView& view = paging_ ? page_view_ : chat_view_;
+    const uint64_t top = view.first_visible();
+    if (view.scroll_pending() || top == ChatLogView::NO_ROW) return;  // let a jump land first
+
+    if (!paging_) {
+        // Scrolling up past the oldest in-memory message pages history in from disk
+        if (scrolled_up && top <= chat_log_.first_index()) {
+            load_page(top);
+            paging_ = true;
+        }
+        return;
+    }
+
+    // Back among messages the live log still holds: hand over to the live view at the same row
+    const uint64_t live_margin = std::max<uint64_t>(1, std::min<uint64_t>(PAGE_MARGIN_ROWS, chat_log_.size() / 2));
+    if (top >= chat_log_.first_index() + live_margin) {
+        paging_ = false;
+        chat_view_.scroll_to(top, 0.0f);
+        return;
+    }
+
+    bool near_start = top < page_log_.first_index() + PAGE_MARGIN_ROWS && page_log_.first_index() > 0;
+    bool near_end = top + PAGE_MARGIN_ROWS > page_log_.end_index() && page_log_.end_index() < chat_log_.end_index();
+    if (near_start || near_end) {
+        load_page(top);
+    }
+}
+
+void ChatGui::load_page(uint64_t anchor) {
+    const uint64_t first = anchor > PAGE_ROWS ? anchor - PAGE_ROWS : 0;
+    const uint64_t end = std::min(chat_log_.end_index(), first + page_log_.capacity());
+
+    // Older rows come from the mapped file, the rest straight from the live log
+    page_log_.reset(first);
+    ScrollbackStore::Record record;
+    for (uint64_t index = first; index < end; ++index) {
+        if (chat_log_.contains(index)) {
+            page_log_.append(chat_log_.sender(index), chat_log_.text(index), chat_log_.entry(index).timestamp_ms);
+        } else if (scrollback_.read(index, record)) {
+            page_log_.append(record.sender, record.text, record.timestamp_ms);
+        } else {
+            break;
+        }
+    }
+    page_view_.scroll_to(anchor, 0.0f);
+}
+
+void ChatGui::update_remote_history(bool scrolled_up, bool pulled_past_bottom) {
+    if (!remote_paging_) {
+        // Scrolling up past the oldest local message (live or paged in from disk) of a room
+        // that has older messages on the server switches to the server's history
+        if (!scrolled_up || room_first_seq_ <= 1 || remote_exhausted_ || !is_connected()) return;
+        ChatLogView& view = paging_ ? page_view_ : chat_view_;
+        const ChatLog& log = paging_ ? page_log_ : chat_log_;
+        const uint64_t top = view.first_visible();
+        if (view.scroll_pending() || top == ChatLogView::NO_ROW || top > log.first_index()) return;
+        if (paging_ ? log.first_index() > 0 : scrollback_.end_index() > 0) return;  // disk first
+
+        paging_ = false;
+        remote_paging_ = true;
+        remote_log_.reset(room_first_seq_);
+        fetch_remote(room_first_seq_, REMOTE_PAGE_ROWS);
+        return;
+    }
+
+    if (remote_pending_ || remote_view_.scroll_pending()) return;
+
+    // Pulling past the newest row either continues downwards or, once the window reaches
+    // what was received live, hands over to the live view at the seam
+    if (pulled_past_bottom) {
+        if (remote_log_.end_index() < room_first_seq_) {
+            const uint64_t before = std::min(room_first_seq_, remote_log_.end_index() + REMOTE_PAGE_ROWS);
+            fetch_remote(before, before - remote_log_.end_index());
+        } else {
+            leave_remote_history();
+            if (chat_log_.contains(room_first_row_)) {
+                chat_view_.scroll_to(room_first_row_, 0.0f);
+            } else {
+                scroll_to_bottom_ = 1.0f;
+            }
+        }
+        return;
+    }
+
+    const uint64_t top = remote_view_.first_visible();
+    if (top != ChatLogView::NO_ROW && !remote_exhausted_ && top < remote_log_.first_index() + REMOTE_MARGIN_ROWS) {
+        fetch_remote(remote_log_.first_index(), REMOTE_PAGE_ROWS);
+    }
+}
+
+void ChatGui::fetch_remote(uint64_t before_seq, uint64_t count) {
+    // The page arrives on the network thread; it is handled here on a later frame
+    const uint64_t request = ++remote_request_;
+    remote_pending_ = client_->fetch_history(room_, before_seq, (size_t)count, [this, request](const HistoryPage& page) {
+        ui_dispatcher_.post([this, request, page]() {
+            if (request == remote_request_) on_history_page(page);
+        });
+    });
+}
+
+void ChatGui::on_history_page(const HistoryPage& page) {
+    remote_pending_ = false;
+    if (!page.complete || page.room != room_) return;  // disconnected meanwhile; scrolling retries
+    if (page.messages.empty()) {
+        remote_exhausted_ = remote_log_.first_index() <= std::max<uint64_t>(page.first_seq, 1);
+        return;
+    }
+
+    const uint64_t first = page.messages.front().seq;
+    if (first >= remote_log_.end_index()) {
+        // Newer rows continue the window downwards; ChatLog drops the oldest once full
+        for (const MessageView& message : page.messages) {
+            if (message.seq != remote_log_.end_index()) break;
+            append_remote(remote_log_, message);
+        }
+        remote_exhausted_ = remote_exhausted_ && remote_log_.first_index() <= page.first_seq;
+        return;
+    }
+
+    // Older rows: rebuild with the page in front; if that overflows, the newest rows go
+    const bool initial = remote_log_.empty();
+    const uint64_t anchor = remote_view_.first_visible();
+    ChatLog rebuilt(REMOTE_ROWS);
+    rebuilt.reset(first);
+    for (const MessageView& message : page.messages) {
+        if (message.seq != rebuilt.end_index() || message.seq >= remote_log_.first_index()) break;
+        append_remote(rebuilt, message);
+    }
+    if (rebuilt.end_index() == remote_log_.first_index()) {
+        for (uint64_t index = remote_log_.first_index(); index < remote_log_.end_index(); ++index) {
+            if (rebuilt.size() == rebuilt.capacity()) break;
+            rebuilt.append(remote_log_.sender(index), remote_log_.text(index), remote_log_.entry(index).timestamp_ms);
+        }
+    }
+    remote_log_ = std::move(rebuilt);
+    remote_exhausted_ = first <= page.first_seq;
+
+    // Keep the row under the viewport's top edge in place, or start at the newest row
+    if (!initial && remote_log_.contains(anchor)) {
+        remote_view_.scroll_to(anchor, 0.0f);
+    } else {
+        remote_view_.scroll_to(remote_log_.end_index() - 1, 1.0f);
+    }
+}
+
+// Erased messages keep their row (and seq) as a placeholder, so the window stays contiguous
+void ChatGui::append_remote(ChatLog& log, const MessageView& message) {
+    if (message.deleted) {
+        log.append("System", "(message deleted)", message.timestamp_ms);
+    } else {
+        log.append(message.sender, message.text, message.timestamp_ms);
+    }
+}
+
+void ChatGui::leave_remote_history() {
+    remote_paging_ = false;
+    remote_pending_ = false;
+    ++remote_request_;  // an answer still in flight is dropped
+}
+
+void ChatGui::render_profiler() {
+#if CHAT_PROFILER
+    if (ImGui::IsKeyPressed(ImGuiKey_F3, false)) {
+        show_profiler_ = !show_profiler_;
+    }
+    if (!show_profiler_) return;
+
+    FrameProfiler& profiler = FrameProfiler::instance();
+    profiler.set_queue_depth(backlog_);
+
+    // The kernel's RTT estimate is a syscall; once a second is plenty for the overlay
+    const double now = glfwGetTime();
+    if (now - last_rtt_poll_ >= RTT_POLL_SECONDS) {
+        last_rtt_poll_ = now;
+        std::chrono::microseconds rtt;
+        profiler.set_rtt(client_->round_trip_time(rtt) ? rtt.count() / 1000.0 : -1.0);
+    }
+
+    profiler.draw_overlay(&show_profiler_);
+#endif
+}
+
 void ChatGui::render_input_area() {
     ImGui::SetNextWindowPos(ImVec2(0, ImGui::GetIO().DisplaySize.y - 50), ImGuiCond_Always);
     ImGui::SetNextWindowSize(ImVec2(ImGui::GetIO().DisplaySize.x, 50), ImGuiCond_Always);
@@ -190,7 +600,9 @@ void ChatGui::render_input_area() {
     ImGui::Begin("Input", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize | 
                                     ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoCollapse);
 
-    if (!is_connected()) {
+    if (last_state_ == ConnectionState::Resolving || last_state_ == ConnectionState::Connecting) {
+        ImGui::TextColored(ImVec4(1, 1, 0, 1), "Connecting...");
+    } else if (!is_connected()) {
         ImGui::TextColored(ImVec4(1, 0, 0, 1), "Not connected");
     }
 
@@ -206,6 +618,8 @@ void ChatGui::render_input_area() {
             std::string msg(input_buffer_);
             if (!msg.empty()) {
                 if (client_->send_message(msg)) {
+                    paging_ = false;  // sending returns to the live tail
+                    leave_remote_history();
                     add_chat_message("You", msg);
                 }
             }
@@ -217,22 +631,87 @@ void ChatGui::render_input_area() {
 }
 
 void ChatGui::handle_incoming_messages() {
-    while (client_->has_pending_messages()) {
-        std::string msg = client_->receive_message();
-        if (!msg.empty()) {
-            add_chat_message("Remote", msg);
+    using clock = std::chrono::steady_clock;
+    const auto deadline = clock::now() + std::chrono::duration<double, std::milli>(DRAIN_BUDGET_MS);
+
+    // Batches under one queue lock, one timestamp per batch, until the count or time budget runs out
+    size_t drained = 0;
+    while (drained < MAX_MESSAGES_PER_FRAME && clock::now() < deadline) {
+        size_t count = client_->receive_views(incoming_, std::min(DRAIN_BATCH, MAX_MESSAGES_PER_FRAME - drained));
+        if (count == 0) break;
+
+        const int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        for (const MessageView& msg : incoming_) {
+            if (msg.text.empty()) continue;
+
+            // Server notices carry no sender or timestamp
+            const uint64_t index = store_message(msg.sender.empty() ? std::string_view("Remote") : msg.sender,
+                                                 msg.text, msg.timestamp_ms != 0 ? msg.timestamp_ms : now_ms);
+            if (msg.seq != 0 && !msg.late && msg.room != room_) {
+                // First message of a room (e.g. after /join): its history starts below this one
+                leave_remote_history();
+                room_ = std::string(msg.room);
+                room_first_seq_ = msg.seq;
+                room_first_row_ = index;
+                remote_exhausted_ = false;
+            }
         }
+        incoming_.clear();  // hands the receive buffers back to the pool
+        drained += count;
+    }
+#if CHAT_PROFILER
+    FrameProfiler::instance().add_messages(drained);
+#endif
+
+    // A selected search hit or paged-in history stays put while new messages arrive
+    if (drained > 0 && search_cursor_ == NO_HIT && !paging_ && !remote_paging_) {
+        scroll_to_bottom_ = 1.0f;
+    }
+    backlog_ = client_->pending_count();
+}
+
+void ChatGui::on_connection_state(ConnectionState state, const std::string& detail) {
+    if (state == last_state_) return;
+    last_state_ = state;
+
+    switch (state) {
+        case ConnectionState::Connected:
+            connected_ = true;
+            room_.clear();  // the server replays the room on join, which sets it again
+            room_first_seq_ = 0;
+            leave_remote_history();
+            add_chat_message("System", "Connected!");
+            break;
+        case ConnectionState::Failed:
+            connected_ = false;
+            add_chat_message("System", detail.empty() ? "Connection failed" : "Connection failed: " + detail);
+            break;
+        case ConnectionState::Disconnected:
+            if (connected_) {
+                connected_ = false;
+                add_chat_message("System", "Disconnected");
+            }
+            break;
+        default:
+            break;
     }
 }
 
-void ChatGui::add_chat_message(const std::string& sender, const std::string& message) {
-    std::string formatted = "[" + sender + "]: " + message;
-    chat_log_.push_back(formatted);
+void ChatGui::add_chat_message(std::string_view sender, std::string_view message) {
+    // The only copy between the network buffer and the log: straight into its arena
+    const int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    store_message(sender, message, now_ms);
 
-    // Limit chat log size to avoid memory issues
-    if (chat_log_.size() > 1000) {
-        chat_log_.erase(chat_log_.begin());
+    if (!paging_ && !remote_paging_) {
+        scroll_to_bottom_ = 1.0f;
     }
+}
 
-    scroll_to_bottom_ = 1.0f;
+uint64_t ChatGui::store_message(std::string_view sender, std::string_view text, int64_t timestamp_ms) {
+    // Indexed on the way in; ChatLog's evict handler takes it back out
+    uint64_t index = chat_log_.append(sender, text, timestamp_ms);
+    search_index_.add(index, sender, text);
+    return index;
 }
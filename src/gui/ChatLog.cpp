@@ -0,0 +1,199 @@
+#include "gui/ChatLog.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+ChatLog::ChatLog(size_t capacity)
+    : capacity_(std::max<size_t>(capacity, 1)), first_(0), end_(0), first_chunk_(0), spare_{nullptr, 0, 0} {
+}
+
+size_t ChatLog::capacity() const {
+    return capacity_;
+}
+
+void ChatLog::set_capacity(size_t capacity) {
+    capacity = std::max<size_t>(capacity, 1);
+    if (capacity == capacity_) return;
+
+    // Re-seat the retained records so slot == index % capacity still holds
+    uint64_t keep_from = std::max(first_, end_ - std::min<uint64_t>(end_ - first_, capacity));
+    notify_evicted(first_, keep_from);
+    release_senders(first_, keep_from);
+    std::vector<ChatEntry> entries(std::min<uint64_t>(end_, capacity));
+    for (uint64_t index = keep_from; index < end_; ++index) {
+        entries[index % capacity] = entries_[index % capacity_];
+    }
+
+    entries_.swap(entries);
+    capacity_ = capacity;
+    first_ = keep_from;
+    release_chunks();
+}
+
+size_t ChatLog::size() const {
+    return (size_t)(end_ - first_);
+}
+
+bool ChatLog::empty() const {
+    return end_ == first_;
+}
+
+void ChatLog::clear() {
+    notify_evicted(first_, end_);
+    senders_.clear();
+    sender_ids_.clear();
+    free_sender_ids_.clear();
+    entries_.clear();
+    first_ = end_;
+    release_chunks();
+}
+
+void ChatLog::reset(uint64_t first_index) {
+    clear();
+    first_ = end_ = first_index;
+}
+
+uint64_t ChatLog::first_index() const {
+    return first_;
+}
+
+uint64_t ChatLog::end_index() const {
+    return end_;
+}
+
+bool ChatLog::contains(uint64_t index) const {
+    return index >= first_ && index < end_;
+}
+
+const ChatEntry& ChatLog::entry(uint64_t index) const {
+    return entries_[index % capacity_];
+}
+
+std::string_view ChatLog::text(uint64_t index) const {
+    const ChatEntry& record = entry(index);
+    const Chunk& chunk = chunks_[record.chunk - first_chunk_];
+    return std::string_view(chunk.data.get() + record.offset, record.length);
+}
+
+std::string_view ChatLog::sender(uint64_t index) const {
+    return senders_[entry(index).sender_id].name;
+}
+
+uint64_t ChatLog::append(std::string_view sender, std::string_view text, int64_t timestamp_ms) {
+    if (end_ - first_ == capacity_) {
+        evict_oldest();
+    }
+
+    ChatEntry record = store_text(text);
+    record.sender_id = intern_sender(sender);
+    record.timestamp_ms = timestamp_ms;
+
+    size_t slot = (size_t)(end_ % capacity_);
+    if (slot >= entries_.size()) {
+        entries_.resize(slot + 1);  // still filling up (or refilling after clear())
+    }
+    entries_[slot] = record;
+    return end_++;
+}
+
+void ChatLog::on_evict(EvictHandler handler) {
+    evict_handler_ = std::move(handler);
+}
+
+size_t ChatLog::arena_bytes() const {
+    size_t bytes = spare_.capacity;
+    for (const Chunk& chunk : chunks_) {
+        bytes += chunk.capacity;
+    }
+    return bytes;
+}
+
+uint32_t ChatLog::intern_sender(std::string_view sender) {
+    auto it = sender_ids_.find(sender);
+    if (it != sender_ids_.end()) {
+        ++senders_[it->second].refs;
+        return it->second;
+    }
+
+    uint32_t id;
+    if (!free_sender_ids_.empty()) {
+        id = free_sender_ids_.back();
+        free_sender_ids_.pop_back();
+        senders_[id] = Sender{std::string(sender), 1};
+    } else {
+        id = (uint32_t)senders_.size();
+        senders_.push_back(Sender{std::string(sender), 1});
+    }
+    sender_ids_.emplace(senders_[id].name, id);
+    return id;
+}
+
+void ChatLog::release_senders(uint64_t first, uint64_t end) {
+    for (uint64_t index = first; index < end; ++index) {
+        const uint32_t id = entry(index).sender_id;
+        Sender& sender = senders_[id];
+        if (--sender.refs > 0) continue;
+        sender_ids_.erase(sender.name);
+        std::string().swap(sender.name);
+        free_sender_ids_.push_back(id);
+    }
+}
+
+ChatEntry ChatLog::store_text(std::string_view text) {
+    // Messages never straddle chunks; a message larger than CHUNK_SIZE gets a chunk of its own
+    if (chunks_.empty() || chunks_.back().used + text.size() > chunks_.back().capacity) {
+        Chunk chunk{nullptr, 0, 0};
+        if (text.size() <= CHUNK_SIZE && spare_.data) {
+            chunk = std::move(spare_);
+            spare_ = Chunk{nullptr, 0, 0};
+        } else {
+            chunk.capacity = std::max(CHUNK_SIZE, text.size());
+            chunk.data.reset(new char[chunk.capacity]);
+        }
+        chunk.used = 0;
+        chunks_.push_back(std::move(chunk));
+    }
+
+    Chunk& chunk = chunks_.back();
+    ChatEntry record{};
+    record.chunk = first_chunk_ + (uint32_t)(chunks_.size() - 1);
+    record.offset = (uint32_t)chunk.used;
+    record.length = (uint32_t)text.size();
+    if (!text.empty()) std::memcpy(chunk.data.get() + chunk.used, text.data(), text.size());
+    chunk.used += text.size();
+    return record;
+}
+
+void ChatLog::notify_evicted(uint64_t first, uint64_t end) {
+    if (!evict_handler_) return;
+    for (uint64_t index = first; index < end; ++index) {
+        evict_handler_(index);
+    }
+}
+
+void ChatLog::evict_oldest() {
+    notify_evicted(first_, first_ + 1);
+    release_senders(first_, first_ + 1);
+    ++first_;
+    release_chunks();
+}
+
+void ChatLog::release_chunks() {
+    // Keep the chunk of the oldest retained message, or just the write chunk when empty
+    uint32_t keep_from;
+    if (!empty()) {
+        keep_from = entry(first_).chunk;
+    } else {
+        keep_from = first_chunk_ + (uint32_t)chunks_.size() - (chunks_.empty() ? 0 : 1);
+        if (!chunks_.empty()) chunks_.back().used = 0;
+    }
+
+    while (first_chunk_ < keep_from && !chunks_.empty()) {
+        Chunk& front = chunks_.front();
+        if (!spare_.data && front.capacity == CHUNK_SIZE) {
+            spare_ = std::move(front);
+        }
+        chunks_.pop_front();
+        ++first_chunk_;
+    }
+}
@@ -0,0 +1,254 @@
+#include "gui/ChatLogView.hpp"
+#include "gui/ChatLog.hpp"
+#include "gui/FrameProfiler.hpp"
+#include "imgui.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+ChatLogView::ChatLogView()
+    : wrap_width_(-1.0f), font_size_(0.0f), spacing_(0.0f), char_width_(0.0f), layout_epoch_(0),
+      synced_first_(0), synced_end_(0), origin_(0.0f), view_height_(0.0f), first_visible_(NO_ROW),
+      scroll_target_(NO_ROW), scroll_align_(0.5f), scroll_passes_(0), highlight_(NO_ROW) {
+}
+
+float ChatLogView::content_height() const {
+    return block_prefix_.empty() ? 0.0f : block_prefix_.back();
+}
+
+void ChatLogView::scroll_to(uint64_t index, float align) {
+    scroll_target_ = index;
+    scroll_align_ = align;
+    scroll_passes_ = SCROLL_PASSES;
+}
+
+void ChatLogView::apply_scroll(const ChatLog& log) {
+    if (scroll_passes_ == 0) return;
+    if (!log.contains(scroll_target_)) {
+        scroll_passes_ = 0;
+        return;
+    }
+    PROFILE_SCOPE(Layout);
+    if (wrap_width_ < 0.0f) {
+        // Never drawn: aim with the parent's width; the second pass corrects the estimate
+        sync(log, ImGui::GetContentRegionAvail().x, ImGui::GetFontSize(), ImGui::GetStyle().ItemSpacing.y);
+        view_height_ = ImGui::GetContentRegionAvail().y;
+    } else {
+        // Laid out with the last draw's key; draw() re-syncs if the width has changed since
+        sync(log, wrap_width_, font_size_, spacing_);
+    }
+    const float margin = (view_height_ - row(scroll_target_).height) * scroll_align_;
+    ImGui::SetNextWindowScroll(ImVec2(-1.0f, std::max(0.0f, origin_ + row_top(scroll_target_) - margin)));
+    // Otherwise the jump is clamped to the previous frame's content (e.g. another log's)
+    ImGui::SetNextWindowContentSize(ImVec2(0.0f, origin_ + content_height()));
+    --scroll_passes_;
+}
+
+bool ChatLogView::scroll_pending() const {
+    return scroll_passes_ > 0;
+}
+
+uint64_t ChatLogView::first_visible() const {
+    return first_visible_;
+}
+
+void ChatLogView::set_highlight(uint64_t index) {
+    highlight_ = index;
+}
+
+void ChatLogView::draw(const ChatLog& log) {
+    {
+        PROFILE_SCOPE(Layout);
+        sync(log, ImGui::GetContentRegionAvail().x, ImGui::GetFontSize(), ImGui::GetStyle().ItemSpacing.y);
+    }
+
+    const float origin = ImGui::GetCursorPosY();
+    const float top = std::max(0.0f, ImGui::GetScrollY() - origin);
+    const float bottom = top + ImGui::GetWindowHeight();
+    origin_ = origin;
+    view_height_ = ImGui::GetWindowHeight();
+    first_visible_ = NO_ROW;
+
+    if (!log.empty()) {
+        uint64_t index = row_at(top);
+        first_visible_ = index;
+        ImGui::SetCursorPosY(origin + row_top(index));
+
+        // Visible rows flow naturally; each one's real height replaces its estimate
+        ImGui::PushTextWrapPos(0.0f);
+        while (index < log.end_index() && ImGui::GetCursorPosY() - origin < bottom) {
+            std::string_view line = format_row(log, index);
+            const float before = ImGui::GetCursorPosY();
+            if (index == highlight_) {
+                ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.85f, 0.3f, 1.0f));
+            }
+            // Length-delimited so embedded NULs do not cut a message short
+            ImGui::TextUnformatted(line.data(), line.data() + line.size());
+            if (index == highlight_) {
+                ImGui::PopStyleColor();
+            }
+            store_measured(index, ImGui::GetCursorPosY() - before);
+            ++index;
+        }
+        ImGui::PopTextWrapPos();
+
+        if (!dirty_blocks_.empty()) {
+            PROFILE_SCOPE(Layout);
+            rebuild_blocks(log);
+            rebuild_prefix();
+        }
+    }
+
+    // Reserve the full content height so the scrollbar spans every row
+    ImGui::SetCursorPosY(origin + content_height());
+    ImGui::Dummy(ImVec2(0.0f, 0.0f));
+}
+
+std::string_view ChatLogView::format_row(const ChatLog& log, uint64_t index) {
+    // Formatted only for visible rows; the log itself stores sender and text separately
+    std::string_view sender = log.sender(index);
+    std::string_view text = log.text(index);
+    scratch_.clear();
+    scratch_.append("[").append(sender).append("]: ").append(text);
+    return scratch_;
+}
+
+void ChatLogView::sync(const ChatLog& log, float wrap_width, float font_size, float spacing) {
+    const uint64_t first = log.first_index();
+    const uint64_t end = log.end_index();
+
+    bool capacity_changed = rows_.size() != log.capacity();
+    if (capacity_changed) {
+        rows_.assign(log.capacity(), RowLayout{0.0f, 0, 0});
+        block_heights_.assign(log.capacity() / BLOCK_ROWS + 2, 0.0f);
+    }
+
+    bool layout_changed = std::fabs(wrap_width - wrap_width_) > 0.5f || font_size != font_size_ ||
+                          spacing != spacing_;
+    if (layout_changed) {
+        wrap_width_ = wrap_width;
+        font_size_ = font_size;
+        spacing_ = spacing;
+        const char* sample = "the quick brown fox jumps over the lazy dog THE QUICK BROWN FOX";
+        char_width_ = ImGui::CalcTextSize(sample).x / (float)std::strlen(sample);
+        ++layout_epoch_;
+    }
+
+    if (capacity_changed || layout_changed || first >= synced_end_ || first < synced_first_) {
+        // Rows still cached from the previous sync keep their newline counts
+        relayout_all(log, !capacity_changed);
+    } else {
+        if (first > synced_first_) {
+            dirty_blocks_.push_back(first / BLOCK_ROWS);  // partially evicted head block
+        }
+        for (uint64_t index = synced_end_; index < end; ++index) {
+            init_row(log, index, true);
+        }
+    }
+
+    synced_first_ = first;
+    synced_end_ = end;
+    if (!dirty_blocks_.empty()) {
+        rebuild_blocks(log);
+        rebuild_prefix();
+    } else if (block_prefix_.empty()) {
+        rebuild_prefix();
+    }
+}
+
+void ChatLogView::relayout_all(const ChatLog& log, bool rows_known) {
+    for (uint64_t index = log.first_index(); index < log.end_index(); ++index) {
+        bool known = rows_known && index >= synced_first_ && index < synced_end_;
+        init_row(log, index, !known);
+    }
+}
+
+void ChatLogView::init_row(const ChatLog& log, uint64_t index, bool count_newlines) {
+    RowLayout& layout = row(index);
+    std::string_view text = log.text(index);
+    if (count_newlines) {
+        layout.newlines = (uint32_t)std::count(text.begin(), text.end(), '\n');
+    }
+    layout.height = estimate_height(layout, log.sender(index).size() + text.size() + 4);
+    layout.epoch = 0;
+
+    uint64_t block_id = index / BLOCK_ROWS;
+    if (dirty_blocks_.empty() || dirty_blocks_.back() != block_id) {
+        dirty_blocks_.push_back(block_id);
+    }
+}
+
+float ChatLogView::estimate_height(const RowLayout& layout, size_t length) const {
+    float lines = (float)layout.newlines + 1.0f;
+    if (wrap_width_ > 0.0f) {
+        lines = std::max(lines, (float)layout.newlines + std::ceil(length * char_width_ / wrap_width_));
+    }
+    return lines * font_size_ + spacing_;
+}
+
+void ChatLogView::store_measured(uint64_t index, float height) {
+    RowLayout& layout = row(index);
+    if (layout.epoch == layout_epoch_ && layout.height == height) return;
+
+    bool changed = layout.height != height;
+    layout.height = height;
+    layout.epoch = layout_epoch_;
+    if (changed) {
+        dirty_blocks_.push_back(index / BLOCK_ROWS);
+    }
+}
+
+void ChatLogView::rebuild_blocks(const ChatLog& log) {
+    std::sort(dirty_blocks_.begin(), dirty_blocks_.end());
+    dirty_blocks_.erase(std::unique(dirty_blocks_.begin(), dirty_blocks_.end()), dirty_blocks_.end());
+
+    // Summed from scratch over retained rows, so evictions and float drift never accumulate
+    for (uint64_t block_id : dirty_blocks_) {
+        uint64_t begin = std::max(log.first_index(), block_id * BLOCK_ROWS);
+        uint64_t end = std::min(log.end_index(), (block_id + 1) * BLOCK_ROWS);
+        float sum = 0.0f;
+        for (uint64_t index = begin; index < end; ++index) {
+            sum += row(index).height;
+        }
+        block(block_id) = sum;
+    }
+    dirty_blocks_.clear();
+}
+
+void ChatLogView::rebuild_prefix() {
+    block_prefix_.assign(1, 0.0f);
+    if (synced_end_ == synced_first_) return;
+
+    const uint64_t first_block = synced_first_ / BLOCK_ROWS;
+    const uint64_t last_block = (synced_end_ - 1) / BLOCK_ROWS;
+    for (uint64_t block_id = first_block; block_id <= last_block; ++block_id) {
+        block_prefix_.push_back(block_prefix_.back() + block(block_id));
+    }
+}
+
+uint64_t ChatLogView::row_at(float y) const {
+    // Block whose span contains y, then a walk of at most BLOCK_ROWS rows
+    auto it = std::upper_bound(block_prefix_.begin() + 1, block_prefix_.end(), y);
+    if (it == block_prefix_.end()) return synced_end_ - 1;
+
+    size_t k = (size_t)(it - (block_prefix_.begin() + 1));
+    uint64_t block_id = synced_first_ / BLOCK_ROWS + k;
+    uint64_t index = std::max(synced_first_, block_id * BLOCK_ROWS);
+    uint64_t end = std::min(synced_end_, (block_id + 1) * BLOCK_ROWS);
+
+    float top = block_prefix_[k];
+    for (; index + 1 < end; ++index) {
+        top += row(index).height;
+        if (top > y) break;
+    }
+    return index;
+}
+
+float ChatLogView::row_top(uint64_t index) const {
+    size_t k = (size_t)(index / BLOCK_ROWS - synced_first_ / BLOCK_ROWS);
+    float top = block_prefix_[k];
+    for (uint64_t i = std::max(synced_first_, (index / BLOCK_ROWS) * BLOCK_ROWS); i < index; ++i) {
+        top += row(i).height;
+    }
+    return top;
+}
@@ -0,0 +1,150 @@
+#include "gui/ChatSearchIndex.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+bool is_term_char(char c) {
+    unsigned char u = (unsigned char)c;
+    return u >= 0x80 || (u >= '0' && u <= '9') || (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z');
+}
+
+char fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : (is_term_char(c) ? c : ' ');
+}
+
+}  // namespace
+
+ChatSearchIndex::ChatSearchIndex() : posting_count_(0) {
+}
+
+void ChatSearchIndex::tokenize(std::string_view sender, std::string_view text) {
+    // Fold everything first: tokens_ points into folded_, which must not reallocate afterwards
+    folded_.clear();
+    folded_.reserve(sender.size() + text.size() + 1);
+    for (char c : sender) folded_.push_back(fold(c));
+    folded_.push_back(' ');
+    for (char c : text) folded_.push_back(fold(c));
+
+    tokens_.clear();
+    size_t pos = 0;
+    while (pos < folded_.size()) {
+        while (pos < folded_.size() && folded_[pos] == ' ') ++pos;
+        size_t start = pos;
+        while (pos < folded_.size() && folded_[pos] != ' ') ++pos;
+        if (pos > start) {
+            tokens_.emplace_back(folded_.data() + start, std::min(pos - start, MAX_TERM_LENGTH));
+        }
+    }
+}
+
+void ChatSearchIndex::add(uint64_t index, std::string_view sender, std::string_view text) {
+    tokenize(sender, text);
+    std::sort(tokens_.begin(), tokens_.end());
+    tokens_.erase(std::unique(tokens_.begin(), tokens_.end()), tokens_.end());
+
+    for (std::string_view token : tokens_) {
+        auto it = terms_.find(token);
+        if (it == terms_.end()) {
+            it = terms_.emplace(std::string(token), Postings{}).first;
+        }
+        it->second.indices.push_back(index);
+        ++posting_count_;
+    }
+}
+
+void ChatSearchIndex::remove(uint64_t index, std::string_view sender, std::string_view text) {
+    tokenize(sender, text);
+    std::sort(tokens_.begin(), tokens_.end());
+    tokens_.erase(std::unique(tokens_.begin(), tokens_.end()), tokens_.end());
+
+    for (std::string_view token : tokens_) {
+        auto it = terms_.find(token);
+        if (it == terms_.end()) continue;
+
+        // Oldest-first eviction: the message is always at the head of its postings
+        Postings& postings = it->second;
+        if (postings.head < postings.indices.size() && postings.indices[postings.head] == index) {
+            ++postings.head;
+            --posting_count_;
+        }
+
+        if (postings.head == postings.indices.size()) {
+            terms_.erase(it);
+        } else if (postings.head >= 64 && postings.head * 2 >= postings.indices.size()) {
+            postings.indices.erase(postings.indices.begin(), postings.indices.begin() + postings.head);
+            postings.head = 0;
+        }
+    }
+}
+
+void ChatSearchIndex::clear() {
+    terms_.clear();
+    posting_count_ = 0;
+}
+
+bool ChatSearchIndex::search(std::string_view query, std::vector<uint64_t>& out, uint64_t from_index) {
+    tokenize(std::string_view(), query);
+    if (tokens_.empty()) return false;
+
+    std::string_view prefix;
+    if (is_term_char(query.back())) {
+        prefix = tokens_.back();
+        tokens_.pop_back();
+    }
+    std::sort(tokens_.begin(), tokens_.end());
+    tokens_.erase(std::unique(tokens_.begin(), tokens_.end()), tokens_.end());
+
+    // One ascending range of candidate indices per term
+    using Range = std::pair<const uint64_t*, const uint64_t*>;
+    std::vector<Range> ranges;
+    for (std::string_view token : tokens_) {
+        auto it = terms_.find(token);
+        if (it == terms_.end()) return true;
+
+        const std::vector<uint64_t>& indices = it->second.indices;
+        const uint64_t* end = indices.data() + indices.size();
+        ranges.emplace_back(std::lower_bound(indices.data() + it->second.head, end, from_index), end);
+    }
+
+    if (!prefix.empty()) {
+        prefix_hits_.clear();
+        size_t merged = 0;
+        for (auto it = terms_.lower_bound(prefix);
+             it != terms_.end() && merged < MAX_PREFIX_TERMS && it->first.compare(0, prefix.size(), prefix) == 0;
+             ++it, ++merged) {
+            const std::vector<uint64_t>& indices = it->second.indices;
+            auto begin = std::lower_bound(indices.begin() + it->second.head, indices.end(), from_index);
+            prefix_hits_.insert(prefix_hits_.end(), begin, indices.end());
+        }
+        if (merged > 1) {
+            std::sort(prefix_hits_.begin(), prefix_hits_.end());
+            prefix_hits_.erase(std::unique(prefix_hits_.begin(), prefix_hits_.end()), prefix_hits_.end());
+        }
+        ranges.emplace_back(prefix_hits_.data(), prefix_hits_.data() + prefix_hits_.size());
+    }
+
+    // Walk the rarest term and advance every other cursor with a binary search
+    std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) {
+        return a.second - a.first < b.second - b.first;
+    });
+    for (const uint64_t* candidate = ranges[0].first; candidate != ranges[0].second; ++candidate) {
+        bool match = true;
+        for (size_t i = 1; i < ranges.size() && match; ++i) {
+            Range& range = ranges[i];
+            range.first = std::lower_bound(range.first, range.second, *candidate);
+            if (range.first == range.second) return true;
+            match = *range.first == *candidate;
+        }
+        if (match) out.push_back(*candidate);
+    }
+    return true;
+}
+
+size_t ChatSearchIndex::term_count() const {
+    return terms_.size();
+}
+
+size_t ChatSearchIndex::posting_count() const {
+    return posting_count_;
+}
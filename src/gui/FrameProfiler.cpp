@@ -0,0 +1,137 @@
+#include "gui/FrameProfiler.hpp"
+#include "imgui.h"
+#include <algorithm>
+#include <cstring>
+
+using clock_type = std::chrono::steady_clock;
+
+static double elapsed_ms(clock_type::time_point since) {
+    return std::chrono::duration<double, std::milli>(clock_type::now() - since).count();
+}
+
+FrameProfiler& FrameProfiler::instance() {
+    static FrameProfiler profiler;
+    return profiler;
+}
+
+FrameProfiler::FrameProfiler()
+    : current_(nullptr), section_ms_{}, frame_start_(clock_type::now()), history_pos_(0), history_count_(0),
+      rate_messages_(0), rate_start_(clock_type::now()), messages_per_second_(0.0), queue_depth_(0), rtt_ms_(-1.0) {
+    std::memset(history_, 0, sizeof(history_));
+}
+
+void FrameProfiler::begin_frame() {
+    frame_start_ = clock_type::now();
+    std::fill(section_ms_, section_ms_ + SECTION_COUNT, 0.0);
+}
+
+void FrameProfiler::end_frame() {
+    for (int section = 0; section < SECTION_COUNT; ++section) {
+        history_[section][history_pos_] = (float)section_ms_[section];
+    }
+    history_[SECTION_COUNT][history_pos_] = (float)elapsed_ms(frame_start_);
+    history_pos_ = (history_pos_ + 1) % HISTORY_FRAMES;
+    history_count_ = std::min(history_count_ + 1, HISTORY_FRAMES);
+
+    const double rate_ms = elapsed_ms(rate_start_);
+    if (rate_ms >= 1000.0) {
+        messages_per_second_ = rate_messages_ * 1000.0 / rate_ms;
+        rate_messages_ = 0;
+        rate_start_ = clock_type::now();
+    }
+}
+
+void FrameProfiler::add_messages(size_t count) {
+    rate_messages_ += count;
+}
+
+void FrameProfiler::set_queue_depth(size_t depth) {
+    queue_depth_ = depth;
+}
+
+void FrameProfiler::set_rtt(double ms) {
+    rtt_ms_ = ms;
+}
+
+void FrameProfiler::draw_overlay(bool* open) {
+    const ImGuiViewport* viewport = ImGui::GetMainViewport();
+    ImGui::SetNextWindowPos(ImVec2(viewport->WorkPos.x + viewport->WorkSize.x - 10.0f, viewport->WorkPos.y + 10.0f),
+                            ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+    ImGui::SetNextWindowBgAlpha(0.85f);
+    const ImGuiWindowFlags flags = ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings |
+                                   ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoMove;
+    if (!ImGui::Begin("Profiler (F3)", open, flags)) {
+        ImGui::End();
+        return;
+    }
+
+    // Last / average / worst over the recorded frames; "Other" is NewFrame and bookkeeping
+    static const char* names[] = {"Drain", "Layout", "Submit", "Render (CPU)", "Other", "Frame"};
+    const size_t count = std::max<size_t>(history_count_, 1);
+    const size_t last = (history_pos_ + HISTORY_FRAMES - 1) % HISTORY_FRAMES;
+    if (ImGui::BeginTable("sections", 4, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("ms");
+        ImGui::TableSetupColumn("last");
+        ImGui::TableSetupColumn("avg");
+        ImGui::TableSetupColumn("max");
+        ImGui::TableHeadersRow();
+        for (int row = 0; row <= SECTION_COUNT + 1; ++row) {
+            float last_ms = 0.0f;
+            float sum_ms = 0.0f;
+            float max_ms = 0.0f;
+            for (size_t i = 0; i < count; ++i) {
+                float value;
+                if (row < SECTION_COUNT) {
+                    value = history_[row][i];
+                } else if (row == SECTION_COUNT) {
+                    value = history_[SECTION_COUNT][i];
+                    for (int section = 0; section < SECTION_COUNT; ++section) value -= history_[section][i];
+                    value = std::max(value, 0.0f);
+                } else {
+                    value = history_[SECTION_COUNT][i];
+                }
+                if (i == last) last_ms = value;
+                sum_ms += value;
+                max_ms = std::max(max_ms, value);
+            }
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(names[row]);
+            ImGui::TableNextColumn();
+            ImGui::Text("%6.2f", last_ms);
+            ImGui::TableNextColumn();
+            ImGui::Text("%6.2f", sum_ms / count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%6.2f", max_ms);
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::PlotLines("##frame_ms", history_[SECTION_COUNT], (int)HISTORY_FRAMES, (int)history_pos_, "frame ms",
+                     0.0f, 33.3f, ImVec2(260.0f, 50.0f));
+
+    ImGui::Text("Queue depth: %zu", queue_depth_);
+    ImGui::Text("Messages/s:  %.0f", messages_per_second_);
+    if (rtt_ms_ >= 0.0) {
+        ImGui::Text("RTT:         %.2f ms", rtt_ms_);
+    } else {
+        ImGui::TextDisabled("RTT:         n/a");
+    }
+
+    ImGui::End();
+}
+
+FrameProfiler::Scope::Scope(Section section)
+    : profiler_(FrameProfiler::instance()), section_(section), start_(clock_type::now()), child_ms_(0.0),
+      parent_(profiler_.current_) {
+    profiler_.current_ = this;
+}
+
+FrameProfiler::Scope::~Scope() {
+    const double elapsed = elapsed_ms(start_);
+    profiler_.section_ms_[section_] += elapsed - child_ms_;
+    if (parent_) {
+        parent_->child_ms_ += elapsed;
+    }
+    profiler_.current_ = parent_;
+}
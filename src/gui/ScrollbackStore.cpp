@@ -0,0 +1,205 @@
+#include "gui/ScrollbackStore.hpp"
+#include <cstring>
+#include <iostream>
+
+ScrollbackStore::ScrollbackStore()
+    : indexed_(0), end_index_(0), cursor_index_(0), cursor_offset_(0) {
+}
+
+ScrollbackStore::~ScrollbackStore() {
+    close();
+}
+
+bool ScrollbackStore::open(const std::string& path) {
+    close();
+    path_ = path;
+
+    if (!data_file_.open(path)) {
+        close();
+        return false;
+    }
+    if (data_file_.size() == 0 && !data_file_.append(MAGIC, sizeof(MAGIC))) {
+        close();
+        return false;
+    }
+    if (!data_map_.open(path) || data_map_.size() < sizeof(MAGIC) ||
+        std::memcmp(data_map_.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        std::cerr << "[ScrollbackStore] " << path << " is not a scrollback file\n";
+        close();
+        return false;
+    }
+    if (!index_file_.open(path + ".idx") || !recover()) {
+        sparse_.clear();  // nothing half-recovered gets flushed by close()
+        close();
+        return false;
+    }
+
+    cursor_index_ = 0;
+    cursor_offset_ = sizeof(MAGIC);
+    return true;
+}
+
+void ScrollbackStore::close() {
+    if (is_open()) {
+        flush();
+    }
+    data_map_.close();
+    data_file_.close();
+    index_file_.close();
+    sparse_.clear();
+    indexed_ = 0;
+    end_index_ = 0;
+    pending_.clear();
+    cursor_index_ = 0;
+    cursor_offset_ = 0;
+}
+
+bool ScrollbackStore::is_open() const {
+    return data_file_.is_open();
+}
+
+uint64_t ScrollbackStore::end_index() const {
+    return end_index_;
+}
+
+bool ScrollbackStore::recover() {
+    const uint64_t data_size = data_map_.size();
+
+    // Trust index entries while they are increasing and inside the data file
+    sparse_.clear();
+    {
+        MappedFile index_map;
+        if (index_file_.size() >= sizeof(uint64_t) && index_map.open(path_ + ".idx")) {
+            const size_t count = index_map.size() / sizeof(uint64_t);
+            for (size_t k = 0; k < count; ++k) {
+                uint64_t offset;
+                std::memcpy(&offset, index_map.data() + k * sizeof(uint64_t), sizeof(offset));
+                bool valid = sparse_.empty() ? offset == sizeof(MAGIC) : offset > sparse_.back();
+                if (!valid || offset >= data_size) break;
+                sparse_.push_back(offset);
+            }
+        }
+    }
+
+    // Scan the records after the last indexed one to find the real end
+    uint64_t index = sparse_.empty() ? 0 : (sparse_.size() - 1) * SPARSE_EVERY;
+    uint64_t offset = sparse_.empty() ? sizeof(MAGIC) : sparse_.back();
+    while (offset + RECORD_HEADER_SIZE <= data_size) {
+        uint32_t lengths[2];
+        std::memcpy(lengths, data_map_.data() + offset, sizeof(lengths));
+        const uint64_t size = RECORD_HEADER_SIZE + (uint64_t)lengths[0] + lengths[1];
+        if (offset + size > data_size) break;
+
+        if (index % SPARSE_EVERY == 0 && index / SPARSE_EVERY == sparse_.size()) {
+            sparse_.push_back(offset);
+        }
+        offset += size;
+        ++index;
+    }
+    while (!sparse_.empty() && sparse_.back() >= offset) {
+        sparse_.pop_back();  // pointed at the torn record
+    }
+    end_index_ = index;
+
+    if (offset < data_size) {
+        std::cerr << "[ScrollbackStore] Dropping " << (data_size - offset) << " bytes of torn tail in " << path_ << "\n";
+        data_map_.close();  // Windows refuses to truncate a mapped region
+        if (!data_file_.truncate(offset) || !data_map_.open(path_)) return false;
+    }
+    if (index_file_.size() != sparse_.size() * sizeof(uint64_t)) {
+        if (!index_file_.truncate(0) || !index_file_.append(sparse_.data(), sparse_.size() * sizeof(uint64_t))) {
+            return false;
+        }
+    }
+    indexed_ = sparse_.size();
+    return true;
+}
+
+bool ScrollbackStore::append(uint64_t index, std::string_view sender, std::string_view text, int64_t timestamp_ms) {
+    if (!is_open() || index != end_index_) return false;
+
+    if (index % SPARSE_EVERY == 0) {
+        sparse_.push_back(data_file_.size() + pending_.size());
+    }
+    const uint32_t lengths[2] = {(uint32_t)text.size(), (uint32_t)sender.size()};
+    pending_.append((const char*)lengths, sizeof(lengths));
+    pending_.append((const char*)&timestamp_ms, sizeof(timestamp_ms));
+    pending_.append(sender.data(), sender.size());
+    pending_.append(text.data(), text.size());
+    ++end_index_;
+
+    if (pending_.size() >= FLUSH_THRESHOLD) {
+        return flush();
+    }
+    return true;
+}
+
+bool ScrollbackStore::flush() {
+    if (!is_open()) return false;
+
+    bool ok = true;
+    if (!pending_.empty()) {
+        ok = data_file_.append(pending_.data(), pending_.size());
+        pending_.clear();
+    }
+    // Index entries follow their data, so the index never points past the end of the file
+    if (ok && indexed_ < sparse_.size()) {
+        ok = index_file_.append(sparse_.data() + indexed_, (sparse_.size() - indexed_) * sizeof(uint64_t));
+        indexed_ = sparse_.size();
+    }
+
+    if (!ok) {
+        // A partial record would misalign everything after it; stop spilling instead
+        std::cerr << "[ScrollbackStore] Write failed, scrollback disabled for " << path_ << "\n";
+        data_file_.close();
+        close();
+    }
+    return ok;
+}
+
+bool ScrollbackStore::read(uint64_t index, Record& out) {
+    if (!is_open() || index >= end_index_) return false;
+    if (!pending_.empty() && !flush()) return false;
+
+    uint64_t at;
+    uint64_t offset;
+    if (cursor_index_ <= index && index - cursor_index_ < SPARSE_EVERY) {
+        at = cursor_index_;
+        offset = cursor_offset_;
+    } else {
+        at = index - index % SPARSE_EVERY;
+        offset = sparse_[index / SPARSE_EVERY];
+    }
+
+    for (;;) {
+        if (!ensure_mapped(offset + RECORD_HEADER_SIZE)) return false;
+        uint32_t lengths[2];
+        std::memcpy(lengths, data_map_.data() + offset, sizeof(lengths));
+        const uint64_t size = RECORD_HEADER_SIZE + (uint64_t)lengths[0] + lengths[1];
+
+        if (at == index) {
+            if (!ensure_mapped(offset + size)) return false;
+            const char* record = data_map_.data() + offset;
+            std::memcpy(&out.timestamp_ms, record + sizeof(lengths), sizeof(out.timestamp_ms));
+            out.sender = std::string_view(record + RECORD_HEADER_SIZE, lengths[1]);
+            out.text = std::string_view(record + RECORD_HEADER_SIZE + lengths[1], lengths[0]);
+
+            cursor_index_ = index + 1;
+            cursor_offset_ = offset + size;
+            return true;
+        }
+        offset += size;
+        ++at;
+    }
+}
+
+bool ScrollbackStore::ensure_mapped(uint64_t end) {
+    if (end <= data_map_.size()) return true;
+
+    // The file has grown since it was mapped
+    if (!data_map_.remap() || end > data_map_.size()) {
+        std::cerr << "[ScrollbackStore] Record beyond the end of " << path_ << "\n";
+        return false;
+    }
+    return true;
+}
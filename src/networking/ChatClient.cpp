@@ -1,10 +1,15 @@
 #include "networking/ChatClient.hpp"
+#include <mstcpip.h>
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 
 #pragma comment(lib, "Ws2_32.lib")
 
 ChatClient::ChatClient()
-    : socket_(INVALID_SOCKET), connected_(false), running_(false) {
+    : runtime_(NetRuntime::instance()), socket_(INVALID_SOCKET), connected_(false), running_(false),
+      frame_checksums_(false), state_(ConnectionState::Disconnected), recv_begin_(0), recv_end_(0), scan_pos_(0),
+      next_history_id_(0), session_checksums_(false) {
 }
 
 ChatClient::~ChatClient() {
@@ -12,82 +17,67 @@ ChatClient::~ChatClient() {
 }
 
 bool ChatClient::connect(const std::string& host, int port) {
-    if (connected_) return true;
+    if (!connect_async(host, port)) return false;
+
+    // Blocking convenience wrapper: wait for the event loop to settle the attempt
+    std::unique_lock<std::mutex> lock(state_mutex_);
+    state_cv_.wait(lock, [this] {
+        return state_ != ConnectionState::Resolving && state_ != ConnectionState::Connecting;
+    });
+    return state_ == ConnectionState::Connected;
+}
 
-    // Initialize Winsock
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
-        std::cerr << "[ChatClient] WSAStartup failed\n";
-        return false;
-    }
+bool ChatClient::connect_async(const std::string& host, int port, std::chrono::milliseconds timeout) {
+    if (running_.exchange(true)) return true;  // already connecting or connected
 
-    // Create socket (initially blocking for connect)
-    socket_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (socket_ == INVALID_SOCKET) {
-        std::cerr << "[ChatClient] socket() failed\n";
-        WSACleanup();
-        return false;
-    }
-
-    // Connect to server (BEFORE making non-blocking)
-    sockaddr_in server_addr{};
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-    
-    if (inet_pton(AF_INET, host.c_str(), &server_addr.sin_addr) != 1) {
-        std::cerr << "[ChatClient] inet_pton() failed for host: " << host << "\n";
-        closesocket(socket_);
-        WSACleanup();
+    if (!runtime_.is_running()) {
+        running_ = false;
+        set_state(ConnectionState::Failed, "network runtime unavailable");
         return false;
     }
 
     std::cerr << "[ChatClient] Attempting to connect to " << host << ":" << port << "\n";
-    
-    if (::connect(socket_, (sockaddr*)&server_addr, sizeof(server_addr)) == SOCKET_ERROR) {
-        int err = WSAGetLastError();
-        std::cerr << "[ChatClient] connect() failed with error: " << err << "\n";
-        closesocket(socket_);
-        WSACleanup();
-        return false;
-    }
-
-    std::cerr << "[ChatClient] Connected successfully to " << host << ":" << port << "\n";
-
-    // NOW set socket to non-blocking (after successful connect)
-    u_long mode = 1;
-    if (ioctlsocket(socket_, FIONBIO, &mode) == SOCKET_ERROR) {
-        std::cerr << "[ChatClient] ioctlsocket() failed\n";
-        closesocket(socket_);
-        WSACleanup();
-        return false;
-    }
-
-    connected_ = true;
-    running_ = true;
-
-    // Start receive thread AFTER connection is confirmed
-    recv_thread_ = std::make_unique<std::thread>(&ChatClient::recv_loop, this);
+    set_state(ConnectionState::Resolving, host);
 
+    auto attempt = std::make_shared<ConnectAttempt>();
+    attempt->host = host;
+    attempt->port = port;
+    runtime_.post([this, attempt, timeout]() { start_connect(attempt, timeout); });
     return true;
 }
 
 void ChatClient::disconnect() {
-    if (!connected_) return;
+    // FIFO task order: every task this client posted earlier has run once this returns
+    runtime_.run_sync([this]() { teardown(); });
 
-    running_ = false;
-    connected_ = false;
-
-    if (recv_thread_ && recv_thread_->joinable()) {
-        recv_thread_->join();
+    if (state() != ConnectionState::Disconnected) {
+        set_state(ConnectionState::Disconnected);
     }
-
-    cleanup();
 }
 
 bool ChatClient::is_connected() const {
     return connected_;
 }
 
+ConnectionState ChatClient::state() const {
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    return state_;
+}
+
+void ChatClient::on_state_change(StateCallback callback) {
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    state_callback_ = std::move(callback);
+}
+
+void ChatClient::on_message(MessageCallback callback) {
+    // Owned by the loop thread so delivery needs no lock per message
+    runtime_.run_sync([this, &callback]() { message_callback_ = std::move(callback); });
+}
+
+void ChatClient::on_messages_pending(WakeCallback callback) {
+    runtime_.run_sync([this, &callback]() { pending_callback_ = std::move(callback); });
+}
+
 bool ChatClient::send_message(const std::string& message) {
     if (!connected_) {
         std::cerr << "[ChatClient] Not connected, cannot send\n";
@@ -99,97 +89,702 @@ bool ChatClient::send_message(const std::string& message) {
         msg.push_back('\n');
     }
 
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    if (socket_ == INVALID_SOCKET) return false;
+
+    if (session_checksums_) {
+        // Each line gets its own checksum; the server splits on '\n' before verifying
+        std::string framed;
+        framed.reserve(msg.size() + FRAME_CHECKSUM_SIZE + 1);
+        size_t begin = 0;
+        while (begin < msg.size()) {
+            const size_t newline = msg.find('\n', begin);
+            std::string_view line(msg.data() + begin, newline - begin);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (!line.empty()) {
+                append_frame_checksum(framed, line);
+                framed.push_back('\n');
+            }
+            begin = newline + 1;
+        }
+        msg.swap(framed);
+        if (msg.empty()) return true;
+    }
+
+    // Earlier bytes still queued: append to preserve ordering, the loop flushes them
+    if (!send_buffer_.empty()) {
+        send_buffer_ += msg;
+        return true;
+    }
+
     int sent = send(socket_, msg.c_str(), (int)msg.size(), 0);
     if (sent == SOCKET_ERROR) {
         int err = WSAGetLastError();
         if (err == WSAECONNRESET || err == WSAECONNABORTED) {
             connected_ = false;
             std::cerr << "[ChatClient] send() - Connection reset by server (error: " << err << ")\n";
-        } else {
+            return false;
+        } else if (err != WSAEWOULDBLOCK) {
             std::cerr << "[ChatClient] send() failed: " << err << "\n";
+            return false;
         }
-        return false;
+        sent = 0;
     }
 
+    if (sent < (int)msg.size()) {
+        // Kernel buffer full: keep the remainder and let the loop wait for writability
+        send_buffer_.assign(msg, (size_t)sent, std::string::npos);
+        runtime_.post([this]() {
+            if (connected_ && socket_ != INVALID_SOCKET) {
+                runtime_.modify(socket_, POLLRDNORM | POLLWRNORM);
+            }
+        });
+    }
     return true;
 }
 
+bool ChatClient::fetch_history(const std::string& room, uint64_t before_seq, size_t count,
+                               HistoryCallback callback) {
+    HistoryQuery query;
+    query.room = room;
+    query.before_seq = before_seq;
+    query.count = count;
+    return request_history(room, std::move(callback), [&query](uint64_t id) {
+        query.id = id;
+        return format_history_command(query);
+    });
+}
+
+bool ChatClient::fetch_history(const std::string& room, std::chrono::system_clock::time_point from,
+                               std::chrono::system_clock::time_point to, size_t count, HistoryCallback callback) {
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+
+    HistoryQuery query;
+    query.room = room;
+    query.by_time = true;
+    query.from_ms = duration_cast<milliseconds>(from.time_since_epoch()).count();
+    query.to_ms = duration_cast<milliseconds>(to.time_since_epoch()).count();
+    query.count = count;
+    return request_history(room, std::move(callback), [&query](uint64_t id) {
+        query.id = id;
+        return format_history_command(query);
+    });
+}
+
+bool ChatClient::search_history(const std::string& room, const std::string& query, uint64_t before_seq,
+                                size_t count, HistoryCallback callback) {
+    SearchQuery search;
+    search.room = room;
+    search.before_seq = before_seq;
+    search.count = count;
+    search.text = query;
+    return request_history(room, std::move(callback), [&search](uint64_t id) {
+        search.id = id;
+        return format_search_command(search);
+    });
+}
+
+bool ChatClient::delete_message(const std::string& room, uint64_t seq) {
+    return send_message(format_delete_command(room, seq));
+}
+
+bool ChatClient::request_history(const std::string& room, HistoryCallback callback,
+                                 const std::function<std::string(uint64_t id)>& format_command) {
+    if (!connected_) return false;
+
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(history_mutex_);
+        id = ++next_history_id_;
+        PendingHistory& pending = history_requests_[id];
+        pending.page.room = room;
+        pending.callback = std::move(callback);
+    }
+
+    if (send_message(format_command(id))) return true;
+
+    // Not sent; unless teardown already failed it (and ran the callback), forget it quietly
+    std::lock_guard<std::mutex> lock(history_mutex_);
+    return history_requests_.erase(id) == 0;
+}
+
 bool ChatClient::has_pending_messages() const {
     std::lock_guard<std::mutex> lock(queue_mutex_);
     return !message_queue_.empty();
 }
 
-std::string ChatClient::receive_message() {
+size_t ChatClient::pending_count() const {
     std::lock_guard<std::mutex> lock(queue_mutex_);
-    if (message_queue_.empty()) return "";
+    return message_queue_.size();
+}
 
-    std::string msg = message_queue_.front();
+size_t ChatClient::receive_views(std::vector<MessageView>& out, size_t max_count) {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    size_t count = std::min(max_count, message_queue_.size());
+    for (size_t i = 0; i < count; ++i) {
+        out.push_back(std::move(message_queue_.front()));
+        message_queue_.pop();
+    }
+    return count;
+}
+
+bool ChatClient::receive_view(MessageView& out) {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (message_queue_.empty()) return false;
+
+    out = std::move(message_queue_.front());
     message_queue_.pop();
-    return msg;
+    return true;
+}
+
+std::string ChatClient::receive_message() {
+    MessageView msg;
+    if (!receive_view(msg)) return "";
+    return msg.to_string();
+}
+
+void ChatClient::set_frame_checksums(bool enabled) {
+    frame_checksums_ = enabled;
+}
+
+void ChatClient::set_user(const std::string& name) {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    user_ = name;
+}
+
+bool ChatClient::round_trip_time(std::chrono::microseconds& out) {
+    // send_mutex_ keeps the loop thread from closing the socket under the query
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    if (socket_ == INVALID_SOCKET || !connected_) return false;
+
+    DWORD version = 0;
+    TCP_INFO_v0 info{};
+    DWORD bytes = 0;
+    if (WSAIoctl(socket_, SIO_TCP_INFO, &version, sizeof(version), &info, sizeof(info), &bytes, nullptr, nullptr) != 0) {
+        return false;  // before Windows 10 1703
+    }
+    out = std::chrono::microseconds(info.RttUs);
+    return true;
+}
+
+void ChatClient::start_connect(const std::shared_ptr<ConnectAttempt>& attempt, std::chrono::milliseconds timeout) {
+    if (!running_ || attempt_) return;  // disconnected before the loop picked this up
+    attempt_ = attempt;
+
+    // The deadline also covers older WSAPoll builds that never report a refused non-blocking connect
+    std::weak_ptr<ConnectAttempt> weak = attempt;
+    attempt->deadline_timer = runtime_.add_timer(timeout, [this, weak]() {
+        if (auto current = weak.lock()) {
+            current->deadline_timer = 0;
+            fail_connect(current, "timed out");
+        }
+    });
+
+    runtime_.resolve(attempt->host, attempt->port,
+                     [this, weak](const std::vector<ResolvedAddress>& addresses, int error) {
+        auto current = weak.lock();
+        if (!current || current != attempt_) return;  // abandoned while resolving
+
+        if (error != 0 || addresses.empty()) {
+            fail_connect(current, "could not resolve host (error: " + std::to_string(error) + ")");
+            return;
+        }
+
+        // Interleave address families, preferred family first, so one dead path costs at most one delay
+        std::vector<ResolvedAddress> preferred, other;
+        for (const auto& address : addresses) {
+            (address.family == addresses.front().family ? preferred : other).push_back(address);
+        }
+        for (size_t i = 0; i < std::max(preferred.size(), other.size()); ++i) {
+            if (i < preferred.size()) current->candidates.push_back(preferred[i]);
+            if (i < other.size()) current->candidates.push_back(other[i]);
+        }
+
+        set_state(ConnectionState::Connecting, current->host);
+        start_next_attempt(current);
+    });
 }
 
-void ChatClient::recv_loop() {
-    char buffer[BUFFER_SIZE];
+void ChatClient::start_next_attempt(const std::shared_ptr<ConnectAttempt>& attempt) {
+    if (attempt->stagger_timer) {
+        runtime_.cancel_timer(attempt->stagger_timer);
+        attempt->stagger_timer = 0;
+    }
+
+    std::weak_ptr<ConnectAttempt> weak = attempt;
+    while (attempt->next_candidate < attempt->candidates.size()) {
+        const ResolvedAddress& address = attempt->candidates[attempt->next_candidate++];
 
-    while (running_) {
-        if (!connected_) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        SOCKET sock = socket(address.family, address.socktype, address.protocol);
+        if (sock == INVALID_SOCKET) {
+            attempt->last_error = WSAGetLastError();
             continue;
         }
+        u_long mode = 1;
+        if (ioctlsocket(sock, FIONBIO, &mode) == SOCKET_ERROR ||
+            (::connect(sock, (const sockaddr*)&address.addr, address.addrlen) == SOCKET_ERROR &&
+             WSAGetLastError() != WSAEWOULDBLOCK)) {
+            attempt->last_error = WSAGetLastError();
+            closesocket(sock);
+            continue;
+        }
+
+        attempt->pending.push_back(sock);
+        runtime_.watch(sock, POLLWRNORM, [this, weak, sock](short revents) {
+            if (auto current = weak.lock()) {
+                on_connect_event(current, sock, revents);
+            }
+        });
+
+        // Race the next candidate if this one has not finished within ATTEMPT_DELAY
+        if (attempt->next_candidate < attempt->candidates.size()) {
+            attempt->stagger_timer = runtime_.add_timer(ATTEMPT_DELAY, [this, weak]() {
+                if (auto current = weak.lock()) {
+                    current->stagger_timer = 0;
+                    start_next_attempt(current);
+                }
+            });
+        }
+        return;
+    }
 
-        int n = recv(socket_, buffer, BUFFER_SIZE - 1, 0);
+    if (attempt->pending.empty()) {
+        fail_connect(attempt, "connect() failed with error: " + std::to_string(attempt->last_error));
+    }
+}
 
-        if (n > 0) {
-            buffer[n] = '\0';
-            std::string msg(buffer);
+void ChatClient::on_connect_event(const std::shared_ptr<ConnectAttempt>& attempt, SOCKET sock, short revents) {
+    runtime_.unwatch(sock);
+    attempt->pending.erase(std::remove(attempt->pending.begin(), attempt->pending.end(), sock),
+                           attempt->pending.end());
+
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(sock, SOL_SOCKET, SO_ERROR, (char*)&err, &len);
+    if (err == 0 && !(revents & (POLLERR | POLLHUP))) {
+        finish_connect(attempt, sock);
+        return;
+    }
 
-            // Queue the message
-            {
-                std::lock_guard<std::mutex> lock(queue_mutex_);
-                message_queue_.push(msg);
+    attempt->last_error = err;
+    closesocket(sock);
+
+    // Nothing left in flight: move to the next candidate now instead of waiting out the delay
+    if (attempt->pending.empty()) {
+        start_next_attempt(attempt);
+    }
+}
+
+void ChatClient::finish_connect(const std::shared_ptr<ConnectAttempt>& attempt, SOCKET sock) {
+    abandon_attempt(attempt);
+
+    short events = POLLRDNORM;
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        socket_ = sock;
+        send_buffer_.clear();
+        // Queued ahead of anything send_message() adds, so every checksummed line follows it
+        session_checksums_ = frame_checksums_;
+        if (session_checksums_) {
+            send_buffer_ = "/checksums\n";
+        }
+        if (!user_.empty()) {
+            const std::string command = format_user_command(user_);
+            if (session_checksums_) {
+                append_frame_checksum(send_buffer_, command);
+            } else {
+                send_buffer_ += command;
             }
+            send_buffer_.push_back('\n');
+        }
+        if (!send_buffer_.empty()) {
+            events |= POLLWRNORM;
+        }
+    }
+    sequences_.clear();
+    connected_ = true;
+    runtime_.watch(sock, events, [this](short revents) { on_socket_event(revents); });
+
+    std::cerr << "[ChatClient] Connected successfully to " << attempt->host << ":" << attempt->port << "\n";
+    set_state(ConnectionState::Connected, attempt->host + ":" + std::to_string(attempt->port));
+}
+
+void ChatClient::fail_connect(const std::shared_ptr<ConnectAttempt>& attempt, const std::string& error) {
+    abandon_attempt(attempt);
+    running_ = false;
+
+    std::cerr << "[ChatClient] Could not connect to " << attempt->host << ":" << attempt->port
+              << ": " << error << "\n";
+    set_state(ConnectionState::Failed, error);
+}
+
+void ChatClient::abandon_attempt(const std::shared_ptr<ConnectAttempt>& attempt) {
+    // Losers of the race and outstanding timers are dropped
+    for (SOCKET sock : attempt->pending) {
+        runtime_.unwatch(sock);
+        closesocket(sock);
+    }
+    attempt->pending.clear();
+
+    if (attempt->deadline_timer) runtime_.cancel_timer(attempt->deadline_timer);
+    if (attempt->stagger_timer) runtime_.cancel_timer(attempt->stagger_timer);
+    attempt->deadline_timer = 0;
+    attempt->stagger_timer = 0;
+
+    if (attempt_ == attempt) {
+        attempt_.reset();
+    }
+}
+
+void ChatClient::on_socket_event(short revents) {
+    if (revents & POLLWRNORM) {
+        flush_send_buffer();
+    }
+    if (revents & (POLLRDNORM | POLLHUP | POLLERR)) {
+        on_readable();
+    }
+}
+
+void ChatClient::on_readable() {
+    for (int i = 0; i < MAX_READS_PER_EVENT && socket_ != INVALID_SOCKET; ++i) {
+        prepare_recv_buffer();
+        if (socket_ == INVALID_SOCKET) return;  // a message callback disconnected us
+        int n = recv(socket_, recv_buffer_->data() + recv_end_, (int)(recv_buffer_->capacity() - recv_end_), 0);
+
+        if (n > 0) {
+            recv_end_ += (size_t)n;
+            extract_frames();
         } else if (n == 0) {
-            // Connection closed by server gracefully
-            connected_ = false;
-            std::cerr << "[ChatClient] Server closed connection\n";
-            {
-                std::lock_guard<std::mutex> lock(queue_mutex_);
-                message_queue_.push("[SYSTEM] Server disconnected");
+            // Connection closed by server gracefully; an unterminated last frame still counts
+            if (recv_end_ > recv_begin_) {
+                push_message(MessageView{std::string_view(recv_buffer_->data() + recv_begin_,
+                                                          recv_end_ - recv_begin_), recv_buffer_});
             }
-            break;
+            close_session("[SYSTEM] Server disconnected", "Server closed connection");
+            return;
         } else {
             int err = WSAGetLastError();
+            if (err == WSAEWOULDBLOCK || err == WSAEINTR) return;
+
             // Handle connection errors
             if (err == WSAECONNRESET || err == WSAECONNABORTED) {
-                // Connection was forcibly closed
-                connected_ = false;
-                std::cerr << "[ChatClient] Connection reset by server (error: " << err << ")\n";
-                {
-                    std::lock_guard<std::mutex> lock(queue_mutex_);
-                    message_queue_.push("[SYSTEM] Connection lost");
-                }
-                break;
-            } else if (err != WSAEWOULDBLOCK && err != WSAEINTR) {
-                // Other error
-                std::cerr << "[ChatClient] recv() error: " << err << "\n";
-                connected_ = false;
-                {
-                    std::lock_guard<std::mutex> lock(queue_mutex_);
-                    message_queue_.push("[SYSTEM] Network error");
-                }
-                break;
+                close_session("[SYSTEM] Connection lost",
+                              "Connection reset by server (error: " + std::to_string(err) + ")");
+            } else {
+                close_session("[SYSTEM] Network error", "recv() error: " + std::to_string(err));
             }
+            return;
         }
+    }
+}
+
+void ChatClient::prepare_recv_buffer() {
+    if (!recv_buffer_) {
+        recv_buffer_ = BufferPool::instance().acquire(RECV_BUFFER_SIZE);
+        recv_begin_ = recv_end_ = scan_pos_ = 0;
+        return;
+    }
+
+    size_t pending = recv_end_ - recv_begin_;
+    if (pending == 0 && recv_buffer_.unique()) {
+        // Every frame consumed and released: rewind for free
+        recv_begin_ = recv_end_ = scan_pos_ = 0;
+        return;
+    }
+    if (recv_end_ < recv_buffer_->capacity()) return;  // still room after the partial frame
+
+    size_t capacity = recv_buffer_->capacity();
+    if (pending >= MAX_FRAME_SIZE) {
+        // Oversized frame: hand over what we have and start afresh
+        push_message(MessageView{std::string_view(recv_buffer_->data() + recv_begin_, pending), recv_buffer_});
+        recv_buffer_ = BufferPool::instance().acquire(RECV_BUFFER_SIZE);
+        recv_begin_ = recv_end_ = scan_pos_ = 0;
+        return;
+    }
+    if (pending == capacity) {
+        capacity = std::min(capacity * 2, MAX_FRAME_SIZE);  // one frame fills the block: grow
+    }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    if (recv_buffer_.unique() && capacity == recv_buffer_->capacity()) {
+        // Steady state: compact the partial frame to the front of the same block
+        std::memmove(recv_buffer_->data(), recv_buffer_->data() + recv_begin_, pending);
+    } else {
+        // Views still reference this block (or it is too small): move the partial frame out
+        BufferRef next = BufferPool::instance().acquire(capacity);
+        std::memcpy(next->data(), recv_buffer_->data() + recv_begin_, pending);
+        recv_buffer_ = std::move(next);
     }
+    scan_pos_ -= recv_begin_;
+    recv_begin_ = 0;
+    recv_end_ = pending;
 }
 
+void ChatClient::extract_frames() {
+    while (scan_pos_ < recv_end_ && socket_ != INVALID_SOCKET) {
+        const char* data = recv_buffer_->data();
+        const char* newline = (const char*)std::memchr(data + scan_pos_, '\n', recv_end_ - scan_pos_);
+        if (!newline) {
+            scan_pos_ = recv_end_;
+            return;
+        }
+
+        size_t frame_end = (size_t)(newline - data);
+        size_t length = frame_end - recv_begin_;
+        if (length > 0 && data[recv_begin_ + length - 1] == '\r') --length;
+
+        size_t begin = recv_begin_;
+        recv_begin_ = scan_pos_ = frame_end + 1;
+        if (length > 0) {
+            deliver_frame(MessageView{std::string_view(data + begin, length), recv_buffer_});
+        }
+    }
+}
+
+void ChatClient::reset_recv_buffer() {
+    recv_buffer_.reset();
+    recv_begin_ = recv_end_ = scan_pos_ = 0;
+}
+
+void ChatClient::flush_send_buffer() {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    while (!send_buffer_.empty() && socket_ != INVALID_SOCKET) {
+        int sent = send(socket_, send_buffer_.data(), (int)send_buffer_.size(), 0);
+        if (sent == SOCKET_ERROR) {
+            int err = WSAGetLastError();
+            if (err != WSAEWOULDBLOCK) {
+                std::cerr << "[ChatClient] send() failed: " << err << "\n";
+                send_buffer_.clear();
+            }
+            break;
+        }
+        send_buffer_.erase(0, (size_t)sent);
+    }
+
+    if (send_buffer_.empty() && socket_ != INVALID_SOCKET) {
+        runtime_.modify(socket_, POLLRDNORM);
+    }
+}
+
+void ChatClient::close_session(const std::string& notice, const std::string& reason) {
+    std::cerr << "[ChatClient] " << reason << "\n";
+    push_notice(notice);
+    teardown();
+    set_state(ConnectionState::Disconnected, reason);
+}
+
+void ChatClient::teardown() {
+    if (attempt_) {
+        abandon_attempt(attempt_);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        if (socket_ != INVALID_SOCKET) {
+            runtime_.unwatch(socket_);
+            closesocket(socket_);
+            socket_ = INVALID_SOCKET;
+        }
+        send_buffer_.clear();
+    }
+    reset_recv_buffer();
+
+    connected_ = false;
+    running_ = false;
+    fail_history_requests();
+}
+
+void ChatClient::deliver_frame(MessageView frame) {
+    if (deliver_history(frame)) return;
+
+    AckFrame ack;
+    if (parse_ack_frame(frame.text, ack)) {
+        track_sequence(ack.room, ack.first_seq, ack.last_seq);  // our own messages; nothing to show
+        return;
+    }
+
+    MissedFrame missed;
+    if (parse_missed_frame(frame.text, missed)) {
+        expect_missed(missed);
+        return;
+    }
+
+    ChatFrame chat;
+    if (parse_chat_frame(frame.text, chat)) {
+        auto sequence = sequences_.find(chat.room);
+        frame.late = chat.seq != 0 && sequence != sequences_.end() && chat.seq < sequence->second.next_seq;
+        if (chat.seq != 0 && !track_sequence(chat.room, chat.seq, chat.seq)) return;  // seen before
+        if (chat.deleted) return;  // only fills its seq
+        frame.text = chat.text;
+        frame.room = chat.room;
+        frame.sender = chat.sender;
+        frame.seq = chat.seq;
+        frame.timestamp_ms = chat.timestamp_ms;
+    }
+    push_message(std::move(frame));
+}
+
+bool ChatClient::deliver_history(const MessageView& frame) {
+    uint64_t id;
+    ChatFrame chat;
+    if (parse_history_frame(frame.text, id, chat)) {
+        std::lock_guard<std::mutex> lock(history_mutex_);
+        auto it = history_requests_.find(id);
+        if (it != history_requests_.end()) {
+            MessageView message{chat.text, frame.buffer};
+            message.room = chat.room;
+            message.sender = chat.sender;
+            message.seq = chat.seq;
+            message.timestamp_ms = chat.timestamp_ms;
+            message.deleted = chat.deleted;
+            it->second.page.messages.push_back(std::move(message));
+        }
+        return true;
+    }
+
+    HistoryEnd end;
+    if (!parse_history_end(frame.text, end)) return false;
+
+    PendingHistory finished;
+    {
+        std::lock_guard<std::mutex> lock(history_mutex_);
+        auto it = history_requests_.find(end.id);
+        if (it == history_requests_.end()) return true;
+        finished = std::move(it->second);
+        history_requests_.erase(it);
+    }
+    finished.page.first_seq = end.first_seq;
+    finished.page.complete = true;
+    if (finished.callback) finished.callback(finished.page);
+    return true;
+}
+
+void ChatClient::fail_history_requests() {
+    std::map<uint64_t, PendingHistory> failed;
+    {
+        std::lock_guard<std::mutex> lock(history_mutex_);
+        failed.swap(history_requests_);
+    }
+    for (auto& entry : failed) {
+        if (entry.second.callback) entry.second.callback(entry.second.page);
+    }
+}
+
+bool ChatClient::track_sequence(std::string_view room, uint64_t first_seq, uint64_t last_seq) {
+    auto it = sequences_.find(room);
+    if (it == sequences_.end()) {
+        // First frame from this room: no history expected before it
+        it = sequences_.emplace(std::string(room), RoomSequence{}).first;
+        it->second.first_seq = first_seq;
+        it->second.next_seq = first_seq;
+    }
+    RoomSequence& sequence = it->second;
+
+    if (first_seq >= sequence.next_seq) {
+        if (first_seq > sequence.next_seq) {
+            request_resend(it->first, sequence, sequence.next_seq, first_seq - 1);
+        }
+        sequence.next_seq = last_seq + 1;
+        return true;
+    }
+
+    // Older than the newest seen: new only if it fills a requested gap
+    for (auto gap = sequence.missing.begin(); gap != sequence.missing.end(); ++gap) {
+        if (first_seq < gap->first || first_seq > gap->second) continue;
+        if (gap->first == gap->second) {
+            sequence.missing.erase(gap);
+        } else if (first_seq == gap->first) {
+            ++gap->first;
+        } else if (first_seq == gap->second) {
+            --gap->second;
+        } else {
+            const uint64_t end = gap->second;
+            gap->second = first_seq - 1;
+            sequence.missing.insert(gap + 1, {first_seq + 1, end});
+        }
+        return true;
+    }
+    return false;
+}
+
+void ChatClient::request_resend(const std::string& room, RoomSequence& sequence, uint64_t first_seq,
+                                uint64_t last_seq) {
+    if (last_seq - first_seq + 1 > MAX_RESEND) {
+        std::cerr << "[ChatClient] " << (last_seq - first_seq + 1 - MAX_RESEND) << " missed messages in " << room
+                  << " are too old to recover\n";
+        first_seq = last_seq - MAX_RESEND + 1;
+    }
+    if (sequence.missing.size() >= MAX_MISSING_RANGES) {
+        sequence.missing.erase(sequence.missing.begin());
+    }
+    sequence.missing.emplace_back(first_seq, last_seq);
+
+    std::cerr << "[ChatClient] Gap in " << room << ", requesting seq " << first_seq << "-" << last_seq << "\n";
+    send_message(format_resend_command(room, first_seq, last_seq));
+}
+
+// The frames after a MISSED header may be older than what this connection has seen, so the
+// part of the range not seen yet becomes a gap for them to fill; the rest are duplicates
+void ChatClient::expect_missed(const MissedFrame& missed) {
+    auto it = sequences_.find(missed.room);
+    if (it == sequences_.end()) {
+        it = sequences_.emplace(std::string(missed.room), RoomSequence{}).first;
+        it->second.first_seq = missed.first_seq;
+        it->second.next_seq = missed.first_seq;
+    }
+    RoomSequence& sequence = it->second;
+
+    auto expect = [&sequence](uint64_t first_seq, uint64_t last_seq) {
+        if (sequence.missing.size() >= MAX_MISSING_RANGES) {
+            sequence.missing.erase(sequence.missing.begin());
+        }
+        sequence.missing.emplace_back(first_seq, last_seq);
+    };
+    if (missed.first_seq < sequence.first_seq) {
+        expect(missed.first_seq, std::min(missed.last_seq, sequence.first_seq - 1));
+        sequence.first_seq = missed.first_seq;
+    }
+    if (missed.last_seq >= sequence.next_seq) {
+        expect(std::max(missed.first_seq, sequence.next_seq), missed.last_seq);
+        sequence.next_seq = missed.last_seq + 1;
+    }
+}
+
+void ChatClient::push_message(MessageView message) {
+    if (message_callback_) {
+        message_callback_(message);
+        return;
+    }
+
+    bool was_empty;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        was_empty = message_queue_.empty();
+        message_queue_.push(std::move(message));
+    }
+
+    // Only the empty -> non-empty edge wakes a poller; bursts cost one wakeup
+    if (was_empty && pending_callback_) {
+        pending_callback_();
+    }
+}
+
+void ChatClient::push_notice(const std::string& notice) {
+    BufferRef buffer = BufferPool::instance().copy_of(notice);
+    std::string_view text(buffer->data(), notice.size());
+    push_message(MessageView{text, std::move(buffer)});
+}
+
+void ChatClient::set_state(ConnectionState state, const std::string& detail) {
+    StateCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        state_ = state;
+        callback = state_callback_;
+    }
+    state_cv_.notify_all();
 
-void ChatClient::cleanup() {
-    if (socket_ != INVALID_SOCKET) {
-        closesocket(socket_);
-        socket_ = INVALID_SOCKET;
+    if (callback) {
+        callback(state, detail);
     }
-    WSACleanup();
 }
@@ -0,0 +1,201 @@
+#include "networking/ChatProtocol.hpp"
+#include "storage/Crc32c.hpp"
+#include <charconv>
+#include <cstdio>
+
+size_t format_chat_header(char* out, std::string_view room, uint64_t seq, int64_t timestamp_ms,
+                          std::string_view sender) {
+    room = room.substr(0, MAX_FRAME_NAME);
+    sender = sender.substr(0, MAX_FRAME_NAME);
+    int length = std::snprintf(out, MAX_FRAME_HEADER, "MSG %.*s %llu %lld %.*s ", (int)room.size(), room.data(),
+                               (unsigned long long)seq, (long long)timestamp_ms, (int)sender.size(), sender.data());
+    return length > 0 ? (size_t)length : 0;
+}
+
+size_t format_deleted_frame(char* out, std::string_view room, uint64_t seq, int64_t timestamp_ms) {
+    room = room.substr(0, MAX_FRAME_NAME);
+    int length = std::snprintf(out, MAX_FRAME_HEADER, "DEL %.*s %llu %lld", (int)room.size(), room.data(),
+                               (unsigned long long)seq, (long long)timestamp_ms);
+    return length > 0 ? (size_t)length : 0;
+}
+
+// Splits off the next space-separated field
+static bool next_field(std::string_view& rest, std::string_view& field) {
+    const size_t space = rest.find(' ');
+    if (space == std::string_view::npos || space == 0) return false;
+    field = rest.substr(0, space);
+    rest.remove_prefix(space + 1);
+    return true;
+}
+
+template <typename T>
+static bool to_number(std::string_view field, T& value) {
+    auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+    return result.ec == std::errc() && result.ptr == field.data() + field.size();
+}
+
+bool parse_chat_frame(std::string_view line, ChatFrame& out) {
+    out.deleted = line.substr(0, 4) == "DEL ";
+    if (!out.deleted && line.substr(0, 4) != "MSG ") return false;
+    std::string_view rest = line.substr(4);
+    std::string_view seq;
+    std::string_view timestamp;
+    if (out.deleted) {
+        out.sender = {};
+        out.text = {};
+        return next_field(rest, out.room) && next_field(rest, seq) && to_number(seq, out.seq) &&
+               to_number(rest, out.timestamp_ms);
+    }
+    if (!next_field(rest, out.room) || !next_field(rest, seq) || !next_field(rest, timestamp)) return false;
+
+    // An empty text leaves no space after the sender
+    const size_t space = rest.find(' ');
+    out.sender = rest.substr(0, space);
+    out.text = space == std::string_view::npos ? std::string_view() : rest.substr(space + 1);
+    return !out.sender.empty() && to_number(seq, out.seq) && to_number(timestamp, out.timestamp_ms);
+}
+
+// "<room> <first_seq> <last_seq>" with first_seq <= last_seq
+static bool parse_seq_range(std::string_view rest, std::string_view& room, uint64_t& first_seq, uint64_t& last_seq) {
+    std::string_view first;
+    if (!next_field(rest, room) || !next_field(rest, first)) return false;
+    return to_number(first, first_seq) && to_number(rest, last_seq) && first_seq <= last_seq;
+}
+
+bool parse_ack_frame(std::string_view line, AckFrame& out) {
+    if (line.substr(0, 4) != "ACK ") return false;
+    return parse_seq_range(line.substr(4), out.room, out.first_seq, out.last_seq);
+}
+
+std::string format_missed_frame(std::string_view room, uint64_t first_seq, uint64_t last_seq) {
+    return "MISSED " + std::string(room) + " " + std::to_string(first_seq) + " " + std::to_string(last_seq);
+}
+
+bool parse_missed_frame(std::string_view line, MissedFrame& out) {
+    if (line.substr(0, 7) != "MISSED ") return false;
+    return parse_seq_range(line.substr(7), out.room, out.first_seq, out.last_seq) && out.first_seq >= 1;
+}
+
+std::string format_resend_command(std::string_view room, uint64_t first_seq, uint64_t last_seq) {
+    return "/resend " + std::string(room) + " " + std::to_string(first_seq) + " " + std::to_string(last_seq);
+}
+
+bool parse_resend_command(std::string_view line, std::string_view& room, uint64_t& first_seq, uint64_t& last_seq) {
+    if (line.substr(0, 8) != "/resend ") return false;
+    std::string_view rest = line.substr(8);
+    std::string_view first;
+    if (!next_field(rest, room) || !next_field(rest, first)) return false;
+    return to_number(first, first_seq) && to_number(rest, last_seq) && first_seq >= 1 && first_seq <= last_seq;
+}
+
+std::string format_delete_command(std::string_view room, uint64_t seq) {
+    return "/delete " + std::string(room) + " " + std::to_string(seq);
+}
+
+bool parse_delete_command(std::string_view line, std::string_view& room, uint64_t& seq) {
+    if (line.substr(0, 8) != "/delete ") return false;
+    std::string_view rest = line.substr(8);
+    return next_field(rest, room) && to_number(rest, seq);
+}
+
+std::string format_user_command(std::string_view name) {
+    return "/user " + std::string(name);
+}
+
+bool parse_user_command(std::string_view line, std::string_view& name) {
+    if (line.substr(0, 6) != "/user ") return false;
+    name = line.substr(6);
+    return !name.empty() && name.find(' ') == std::string_view::npos;
+}
+
+std::string format_history_command(const HistoryQuery& query) {
+    std::string line = "/history " + std::to_string(query.id) + " " + std::string(query.room);
+    if (query.by_time) {
+        line += " between " + std::to_string(query.from_ms) + " " + std::to_string(query.to_ms);
+    } else {
+        line += " before " + std::to_string(query.before_seq);
+    }
+    return line + " " + std::to_string(query.count);
+}
+
+bool parse_history_command(std::string_view line, HistoryQuery& out) {
+    if (line.substr(0, 9) != "/history ") return false;
+    std::string_view rest = line.substr(9);
+    std::string_view id;
+    std::string_view kind;
+    if (!next_field(rest, id) || !next_field(rest, out.room) || !next_field(rest, kind) || !to_number(id, out.id)) {
+        return false;
+    }
+
+    std::string_view field;
+    if (kind == "before") {
+        out.by_time = false;
+        if (!next_field(rest, field) || !to_number(field, out.before_seq)) return false;
+    } else if (kind == "between") {
+        out.by_time = true;
+        if (!next_field(rest, field) || !to_number(field, out.from_ms)) return false;
+        if (!next_field(rest, field) || !to_number(field, out.to_ms)) return false;
+    } else {
+        return false;
+    }
+    return to_number(rest, out.count);
+}
+
+std::string format_search_command(const SearchQuery& query) {
+    return "/search " + std::to_string(query.id) + " " + std::string(query.room) + " " +
+           std::to_string(query.before_seq) + " " + std::to_string(query.count) + " " + std::string(query.text);
+}
+
+bool parse_search_command(std::string_view line, SearchQuery& out) {
+    if (line.substr(0, 8) != "/search ") return false;
+    std::string_view rest = line.substr(8);
+    std::string_view id;
+    std::string_view before;
+    std::string_view count;
+    if (!next_field(rest, id) || !next_field(rest, out.room) || !next_field(rest, before) ||
+        !next_field(rest, count)) {
+        return false;
+    }
+    out.text = rest;
+    return !out.text.empty() && to_number(id, out.id) && to_number(before, out.before_seq) &&
+           to_number(count, out.count);
+}
+
+bool parse_history_frame(std::string_view line, uint64_t& id, ChatFrame& out) {
+    if (line.substr(0, 4) != "HIS ") return false;
+    std::string_view rest = line.substr(4);
+    std::string_view field;
+    return next_field(rest, field) && to_number(field, id) && parse_chat_frame(rest, out);
+}
+
+bool parse_history_end(std::string_view line, HistoryEnd& out) {
+    if (line.substr(0, 5) != "HEND ") return false;
+    std::string_view rest = line.substr(5);
+    std::string_view id;
+    std::string_view count;
+    if (!next_field(rest, id) || !next_field(rest, out.room) || !next_field(rest, count)) return false;
+    return to_number(id, out.id) && to_number(count, out.count) && to_number(rest, out.first_seq);
+}
+
+void append_frame_checksum(std::string& out, std::string_view line) {
+    static const char digits[] = "0123456789abcdef";
+    const uint32_t crc = crc32c(line.data(), line.size());
+    out.append(line.data(), line.size());
+    out += " *";
+    for (int shift = 28; shift >= 0; shift -= 4) {
+        out.push_back(digits[(crc >> shift) & 0xF]);
+    }
+}
+
+bool strip_frame_checksum(std::string_view& line) {
+    if (line.size() < FRAME_CHECKSUM_SIZE) return false;
+    const size_t body = line.size() - FRAME_CHECKSUM_SIZE;
+    if (line[body] != ' ' || line[body + 1] != '*') return false;
+
+    uint32_t crc = 0;
+    const char* end = line.data() + line.size();
+    auto result = std::from_chars(line.data() + body + 2, end, crc, 16);
+    if (result.ec != std::errc() || result.ptr != end || crc32c(line.data(), body) != crc) return false;
+    line = line.substr(0, body);
+    return true;
+}
@@ -0,0 +1,100 @@
+#include "networking/MessageBuffer.hpp"
+#include <algorithm>
+#include <cstring>
+
+MessageBuffer::MessageBuffer(size_t capacity)
+    : data_(new char[capacity]), capacity_(capacity), refs_(0) {
+}
+
+BufferRef::BufferRef(MessageBuffer* buffer)
+    : buffer_(buffer) {
+    if (buffer_) {
+        buffer_->refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+BufferRef::BufferRef(const BufferRef& other)
+    : BufferRef(other.buffer_) {
+}
+
+BufferRef::BufferRef(BufferRef&& other) noexcept
+    : buffer_(other.buffer_) {
+    other.buffer_ = nullptr;
+}
+
+BufferRef& BufferRef::operator=(const BufferRef& other) {
+    if (buffer_ != other.buffer_) {
+        BufferRef copy(other);
+        std::swap(buffer_, copy.buffer_);
+    }
+    return *this;
+}
+
+BufferRef& BufferRef::operator=(BufferRef&& other) noexcept {
+    if (this != &other) {
+        reset();
+        buffer_ = other.buffer_;
+        other.buffer_ = nullptr;
+    }
+    return *this;
+}
+
+BufferRef::~BufferRef() {
+    reset();
+}
+
+bool BufferRef::unique() const {
+    return buffer_ && buffer_->refs_.load(std::memory_order_acquire) == 1;
+}
+
+void BufferRef::reset() {
+    if (!buffer_) return;
+    if (buffer_->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        BufferPool::instance().release(buffer_);
+    }
+    buffer_ = nullptr;
+}
+
+BufferPool& BufferPool::instance() {
+    static BufferPool pool;
+    return pool;
+}
+
+BufferPool::~BufferPool() {
+    for (MessageBuffer* buffer : free_) {
+        delete buffer;
+    }
+}
+
+BufferRef BufferPool::acquire(size_t min_capacity) {
+    if (min_capacity <= MAX_CACHED_CAPACITY) {
+        const size_t max_capacity = 2 * std::max(min_capacity, DEFAULT_CAPACITY);
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Most recently released first: likely still warm in cache
+        for (auto it = free_.rbegin(); it != free_.rend(); ++it) {
+            if ((*it)->capacity() >= min_capacity && (*it)->capacity() <= max_capacity) {
+                MessageBuffer* buffer = *it;
+                free_.erase(std::next(it).base());
+                return BufferRef(buffer);
+            }
+        }
+    }
+    return BufferRef(new MessageBuffer(std::max(min_capacity, DEFAULT_CAPACITY)));
+}
+
+BufferRef BufferPool::copy_of(std::string_view text) {
+    BufferRef buffer = acquire(text.size());
+    std::memcpy(buffer->data(), text.data(), text.size());
+    return buffer;
+}
+
+void BufferPool::release(MessageBuffer* buffer) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.size() < MAX_CACHED && buffer->capacity() <= MAX_CACHED_CAPACITY) {
+            free_.push_back(buffer);
+            return;
+        }
+    }
+    delete buffer;
+}
@@ -0,0 +1,278 @@
+#include "networking/NetRuntime.hpp"
+#include <iostream>
+#include <future>
+#include <cstring>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+NetRuntime& NetRuntime::instance() {
+    static NetRuntime runtime;
+    return runtime;
+}
+
+NetRuntime::NetRuntime()
+    : running_(false), wsa_started_(false), wake_socket_(INVALID_SOCKET), wake_pending_(false),
+      poll_fds_dirty_(true), next_timer_id_(1) {
+    // Initialize Winsock once for the whole process
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        std::cerr << "[NetRuntime] WSAStartup failed\n";
+        return;
+    }
+    wsa_started_ = true;
+
+    if (!open_wake_socket()) {
+        std::cerr << "[NetRuntime] Could not create wake socket\n";
+        return;
+    }
+
+    running_ = true;
+    loop_thread_ = std::thread(&NetRuntime::loop, this);
+    for (int i = 0; i < RESOLVER_THREADS; ++i) {
+        resolver_threads_.emplace_back(&NetRuntime::resolver_loop, this);
+    }
+}
+
+NetRuntime::~NetRuntime() {
+    running_ = false;
+    wake();
+    resolve_cv_.notify_all();
+
+    if (loop_thread_.joinable()) {
+        loop_thread_.join();
+    }
+    for (auto& thread : resolver_threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    if (wake_socket_ != INVALID_SOCKET) {
+        closesocket(wake_socket_);
+    }
+    if (wsa_started_) {
+        WSACleanup();
+    }
+}
+
+bool NetRuntime::is_running() const {
+    return running_;
+}
+
+bool NetRuntime::in_loop_thread() const {
+    return std::this_thread::get_id() == loop_thread_.get_id();
+}
+
+void NetRuntime::post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    wake();
+}
+
+void NetRuntime::run_sync(Task task) {
+    if (in_loop_thread() || !running_) {
+        task();
+        return;
+    }
+
+    // Tasks run in FIFO order, so everything posted before this call has run once it returns
+    std::promise<void> done;
+    std::future<void> finished = done.get_future();
+    post([&task, &done]() {
+        task();
+        done.set_value();
+    });
+    finished.wait();
+}
+
+void NetRuntime::watch(SOCKET sock, short events, IoHandler handler) {
+    watches_[sock] = Watch{events, std::make_shared<IoHandler>(std::move(handler))};
+    poll_fds_dirty_ = true;
+}
+
+void NetRuntime::modify(SOCKET sock, short events) {
+    auto it = watches_.find(sock);
+    if (it == watches_.end() || it->second.events == events) return;
+    it->second.events = events;
+    poll_fds_dirty_ = true;
+}
+
+void NetRuntime::unwatch(SOCKET sock) {
+    if (watches_.erase(sock) > 0) {
+        poll_fds_dirty_ = true;
+    }
+}
+
+NetRuntime::TimerId NetRuntime::add_timer(std::chrono::milliseconds delay, Task task) {
+    TimerId id = next_timer_id_++;
+    Clock::time_point deadline = Clock::now() + delay;
+    timers_.emplace(std::make_pair(deadline, id), std::move(task));
+    timer_deadlines_[id] = deadline;
+    return id;
+}
+
+void NetRuntime::cancel_timer(TimerId id) {
+    auto it = timer_deadlines_.find(id);
+    if (it == timer_deadlines_.end()) return;
+    timers_.erase(std::make_pair(it->second, id));
+    timer_deadlines_.erase(it);
+}
+
+void NetRuntime::resolve(const std::string& host, int port, ResolveHandler handler) {
+    {
+        std::lock_guard<std::mutex> lock(resolve_mutex_);
+        resolve_jobs_.push_back(ResolveJob{host, port, std::move(handler)});
+    }
+    resolve_cv_.notify_one();
+}
+
+bool NetRuntime::open_wake_socket() {
+    // A loopback UDP socket connected to itself: WSAPoll has no pipes or eventfds to wait on
+    wake_socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (wake_socket_ == INVALID_SOCKET) return false;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+
+    u_long mode = 1;
+    if (bind(wake_socket_, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        getsockname(wake_socket_, (sockaddr*)&addr, &len) == SOCKET_ERROR ||
+        ::connect(wake_socket_, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        ioctlsocket(wake_socket_, FIONBIO, &mode) == SOCKET_ERROR) {
+        closesocket(wake_socket_);
+        wake_socket_ = INVALID_SOCKET;
+        return false;
+    }
+    return true;
+}
+
+void NetRuntime::wake() {
+    if (wake_socket_ == INVALID_SOCKET || wake_pending_.exchange(true)) return;
+    char byte = 0;
+    send(wake_socket_, &byte, 1, 0);
+}
+
+void NetRuntime::loop() {
+    while (running_) {
+        if (poll_fds_dirty_) {
+            poll_fds_.clear();
+            poll_fds_.push_back(WSAPOLLFD{wake_socket_, POLLRDNORM, 0});
+            for (const auto& entry : watches_) {
+                poll_fds_.push_back(WSAPOLLFD{entry.first, entry.second.events, 0});
+            }
+            poll_fds_dirty_ = false;
+        }
+
+        int ready = WSAPoll(poll_fds_.data(), (unsigned long)poll_fds_.size(), next_timeout_ms());
+        if (ready == SOCKET_ERROR) {
+            int err = WSAGetLastError();
+            if (err != WSAEINTR) {
+                std::cerr << "[NetRuntime] WSAPoll() error: " << err << "\n";
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            continue;
+        }
+
+        if (ready > 0) {
+            if (poll_fds_[0].revents) {
+                char drain[64];
+                wake_pending_ = false;
+                while (recv(wake_socket_, drain, sizeof(drain), 0) > 0) {
+                }
+            }
+
+            // Handlers may watch/unwatch; look each socket up again and keep its handler alive
+            for (size_t i = 1; i < poll_fds_.size(); ++i) {
+                short revents = poll_fds_[i].revents;
+                if (revents == 0) continue;
+                poll_fds_[i].revents = 0;
+
+                auto it = watches_.find(poll_fds_[i].fd);
+                if (it == watches_.end()) continue;
+                std::shared_ptr<IoHandler> handler = it->second.handler;
+                (*handler)(revents);
+            }
+        }
+
+        run_tasks();
+        run_timers();
+    }
+
+    // Let pending run_sync() callers return
+    run_tasks();
+}
+
+void NetRuntime::run_tasks() {
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex_);
+        tasks.swap(tasks_);
+    }
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+void NetRuntime::run_timers() {
+    const Clock::time_point now = Clock::now();
+    while (!timers_.empty() && timers_.begin()->first.first <= now) {
+        auto it = timers_.begin();
+        Task task = std::move(it->second);
+        timer_deadlines_.erase(it->first.second);
+        timers_.erase(it);
+        task();
+    }
+}
+
+int NetRuntime::next_timeout_ms() const {
+    if (timers_.empty()) return -1;
+    auto delay = timers_.begin()->first.first - Clock::now();
+    if (delay <= Clock::duration::zero()) return 0;
+    // Round up so a timer is never woken for just before its deadline
+    return (int)std::chrono::ceil<std::chrono::milliseconds>(delay).count();
+}
+
+void NetRuntime::resolver_loop() {
+    while (true) {
+        ResolveJob job;
+        {
+            std::unique_lock<std::mutex> lock(resolve_mutex_);
+            resolve_cv_.wait(lock, [this] { return !running_ || !resolve_jobs_.empty(); });
+            if (!running_) return;
+            job = std::move(resolve_jobs_.front());
+            resolve_jobs_.erase(resolve_jobs_.begin());
+        }
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+
+        addrinfo* results = nullptr;
+        const std::string service = std::to_string(job.port);
+        int rc = getaddrinfo(job.host.c_str(), service.c_str(), &hints, &results);
+
+        std::vector<ResolvedAddress> addresses;
+        if (rc == 0) {
+            for (const addrinfo* ai = results; ai; ai = ai->ai_next) {
+                ResolvedAddress address{};
+                address.family = ai->ai_family;
+                address.socktype = ai->ai_socktype;
+                address.protocol = ai->ai_protocol;
+                address.addrlen = (int)ai->ai_addrlen;
+                std::memcpy(&address.addr, ai->ai_addr, ai->ai_addrlen);
+                addresses.push_back(address);
+            }
+            freeaddrinfo(results);
+        }
+
+        post([handler = std::move(job.handler), addresses = std::move(addresses), rc]() {
+            handler(addresses, rc);
+        });
+    }
+}
@@ -0,0 +1,58 @@
+#include "networking/UiDispatcher.hpp"
+#include "networking/ChatClient.hpp"
+
+void UiDispatcher::attach(ChatClient& client, MessageHandler on_message, StateHandler on_state) {
+    if (on_message) {
+        client.on_message([this, handler = std::move(on_message)](const MessageView& message) {
+            // Copying the view only bumps the buffer's reference count
+            post([handler, message]() { handler(message); });
+        });
+    }
+    if (on_state) {
+        client.on_state_change([this, handler = std::move(on_state)](ConnectionState state,
+                                                                     const std::string& detail) {
+            post([handler, state, detail]() { handler(state, detail); });
+        });
+    }
+}
+
+void UiDispatcher::set_wake_handler(Task handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wake_handler_ = std::move(handler);
+}
+
+void UiDispatcher::post(Task task) {
+    Task wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) {
+            wake = wake_handler_;
+        }
+        tasks_.push_back(std::move(task));
+    }
+
+    if (wake) {
+        wake();
+    }
+}
+
+size_t UiDispatcher::drain() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) return 0;
+        draining_.swap(tasks_);
+    }
+
+    // Run outside the lock so tasks may post follow-up work
+    for (auto& task : draining_) {
+        task();
+    }
+    size_t count = draining_.size();
+    draining_.clear();
+    return count;
+}
+
+bool UiDispatcher::empty() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tasks_.empty();
+}
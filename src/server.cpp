@@ -1,35 +1,629 @@
-// server.cpp - Windows (Winsock) simple broadcast server
+// server.cpp - Windows (Winsock) chat server with rooms and persistent history
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <iostream>
+#include <fstream>
 #include <thread>
 #include <vector>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <algorithm>
+#include <string>
+#include <string_view>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include "networking/ChatProtocol.hpp"
+#include "networking/MessageBuffer.hpp"
+#include "server/DeliveryCursors.hpp"
+#include "server/MessageLog.hpp"
+#include "server/RecentRing.hpp"
+#include "server/SearchIndex.hpp"
 
 #pragma comment(lib, "Ws2_32.lib")
 
 constexpr int PORT = 54000;
-std::vector<SOCKET> clients;
-std::mutex clients_mtx;
+const char* const HISTORY_DIR = "history";  // one MessageLog directory per room
+const char* const DEFAULT_ROOM = "general";
+const char* const USERS_DIR = "users";      // delivery cursors of signed-in users
+constexpr size_t MAX_LINE = 1024 * 1024;    // longer lines are split, as ChatClient does
+constexpr size_t MAX_ROOMS = 1024;
+constexpr size_t MAX_ROOM_NAME = 32;
+constexpr size_t MAX_REPLY_BYTES = 4 * 1024 * 1024;  // message text per /resend or /history reply
+constexpr uint64_t MAX_MISSED_MESSAGES = 10000;      // per room on sign-in; older ones stay in /history
+constexpr size_t MISSED_BATCH = 1000;                // messages read and sent at a time
+// Per-room history limits unless history/<room>/retention.conf overrides them
+const MessageLog::RetentionPolicy DEFAULT_RETENTION{90ll * 24 * 60 * 60 * 1000, 4ull * 1024 * 1024 * 1024, 0};
+constexpr std::chrono::seconds MAINTENANCE_INTERVAL{60};
+constexpr uint64_t COMPACTION_BYTES_PER_SECOND = 8 * 1024 * 1024;
 
-void broadcast(const std::string& msg, SOCKET except = INVALID_SOCKET) {
-    std::lock_guard<std::mutex> lk(clients_mtx);
-    for (SOCKET s : clients) {
+// A channel: its members, durable history and the recent frames replayed on join.
+// The room lock orders history appends, fan-out and joins, so a joining client's replay
+// and the live frames that follow neither overlap nor leave a gap.
+struct Room {
+    std::string name;
+    std::vector<SOCKET> members;
+    MessageLog history;
+    MessageLog::RetentionPolicy retention;
+    SearchIndex search;  // follows history; declared after it so it is stopped first
+    RecentRing recent;
+    std::mutex mtx;
+};
+
+std::map<std::string, std::unique_ptr<Room>> rooms;  // never removed while the server runs
+std::mutex rooms_mtx;
+std::atomic<int> client_count{0};
+DeliveryCursors cursors;
+
+bool maintenance_stopping = false;  // guarded by maintenance_mtx
+std::mutex maintenance_mtx;
+std::condition_variable maintenance_cv;
+
+int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string peer_name(SOCKET s) {
+    sockaddr_storage addr{};
+    int len = sizeof(addr);
+    char host[INET6_ADDRSTRLEN] = "unknown";
+    if (getpeername(s, (sockaddr*)&addr, &len) == 0) {
+        if (addr.ss_family == AF_INET) {
+            const sockaddr_in* v4 = (const sockaddr_in*)&addr;
+            inet_ntop(AF_INET, &v4->sin_addr, host, sizeof(host));
+            return std::string(host) + ":" + std::to_string(ntohs(v4->sin_port));
+        }
+        if (addr.ss_family == AF_INET6) {
+            const sockaddr_in6* v6 = (const sockaddr_in6*)&addr;
+            inet_ntop(AF_INET6, &v6->sin6_addr, host, sizeof(host));
+            return "[" + std::string(host) + "]:" + std::to_string(ntohs(v6->sin6_port));
+        }
+    }
+    return host;
+}
+
+bool valid_name(std::string_view name) {
+    // Room and user names double as file names under HISTORY_DIR and USERS_DIR
+    if (name.empty() || name.size() > MAX_ROOM_NAME) return false;
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+    });
+}
+
+// Everything in `spans` goes out in one scatter-gather call
+bool send_spans(SOCKET s, const std::vector<std::string_view>& spans) {
+    if (spans.empty()) return true;
+    std::vector<WSABUF> buffers;
+    buffers.reserve(spans.size());
+    for (std::string_view span : spans) {
+        buffers.push_back(WSABUF{(ULONG)span.size(), (CHAR*)span.data()});
+    }
+    DWORD sent = 0;
+    if (WSASend(s, buffers.data(), (DWORD)buffers.size(), &sent, 0, nullptr, nullptr) == SOCKET_ERROR) {
+        std::cerr << "Send error to client (error: " << WSAGetLastError() << "), may need to disconnect\n";
+        return false;
+    }
+    return true;
+}
+
+// Formats stored messages as MSG frames (after `prefix`, if any) in one pooled buffer; each
+// view carries its seq. Erased messages become DEL frames, so the seqs stay consecutive.
+void format_entries(const std::string& room, const std::vector<MessageLog::Entry>& entries,
+                    std::vector<MessageView>& out, std::string_view prefix = {}) {
+    if (entries.empty()) return;
+    size_t bytes = 0;
+    for (const MessageLog::Entry& entry : entries) bytes += prefix.size() + MAX_FRAME_HEADER + entry.text.size() + 1;
+    BufferRef buffer = BufferPool::instance().acquire(bytes);
+
+    char* pos = buffer->data();
+    for (const MessageLog::Entry& entry : entries) {
+        char* frame = pos;
+        if (!prefix.empty()) {
+            std::memcpy(pos, prefix.data(), prefix.size());
+            pos += prefix.size();
+        }
+        if (entry.deleted) {
+            pos += format_deleted_frame(pos, room, entry.seq, entry.timestamp_ms);
+        } else {
+            pos += format_chat_header(pos, room, entry.seq, entry.timestamp_ms, entry.sender);
+            std::memcpy(pos, entry.text.data(), entry.text.size());
+            pos += entry.text.size();
+        }
+        *pos++ = '\n';
+        MessageView view{std::string_view(frame, (size_t)(pos - frame)), buffer};
+        view.seq = entry.seq;
+        out.push_back(std::move(view));
+    }
+}
+
+// Keeps at most MAX_REPLY_BYTES of message text (but at least one message), dropping from
+// the newest end or, with keep_newest, from the oldest
+void trim_to_budget(std::vector<MessageLog::Entry>& entries, bool keep_newest) {
+    size_t bytes = 0;
+    size_t keep = 0;
+    while (keep < entries.size()) {
+        const MessageLog::Entry& entry = entries[keep_newest ? entries.size() - 1 - keep : keep];
+        if (keep > 0 && bytes + entry.text.size() > MAX_REPLY_BYTES) break;
+        bytes += entry.text.size();
+        ++keep;
+    }
+    if (keep_newest) {
+        entries.erase(entries.begin(), entries.end() - keep);
+    } else {
+        entries.resize(keep);
+    }
+}
+
+// Seeds the replay ring from the newest stored messages, so a restart keeps recent context
+void load_recent(Room& room) {
+    const uint64_t end = room.history.durable_seq();
+    const uint64_t count = std::min<uint64_t>(RecentRing::DEFAULT_CAPACITY, end - room.history.first_seq());
+    std::vector<MessageLog::Entry> entries;
+    room.history.read(end - count, (size_t)count, entries);
+
+    std::vector<MessageView> frames;
+    format_entries(room.name, entries, frames);
+    for (const MessageView& frame : frames) {
+        room.recent.push(frame);
+    }
+}
+
+// Per-room limits from history/<room>/retention.conf, one "key = value" per line:
+// max_age_days, max_bytes, max_count (0 = unlimited). Missing keys keep DEFAULT_RETENTION.
+MessageLog::RetentionPolicy load_retention(const std::string& dir) {
+    MessageLog::RetentionPolicy policy = DEFAULT_RETENTION;
+    std::ifstream file(dir + "/retention.conf");
+    std::string line;
+    while (std::getline(file, line)) {
+        const size_t equals = line.find('=');
+        if (line.empty() || line[0] == '#' || equals == std::string::npos) continue;
+        std::string key = line.substr(0, equals);
+        key.erase(std::remove(key.begin(), key.end(), ' '), key.end());
+        const unsigned long long value = std::strtoull(line.c_str() + equals + 1, nullptr, 10);
+        if (key == "max_age_days") {
+            policy.max_age_ms = (int64_t)value * 24 * 60 * 60 * 1000;
+        } else if (key == "max_bytes") {
+            policy.max_bytes = value;
+        } else if (key == "max_count") {
+            policy.max_count = value;
+        } else {
+            std::cerr << "Unknown setting " << key << " in " << dir << "/retention.conf\n";
+        }
+    }
+    return policy;
+}
+
+Room* find_room(const std::string& name, bool create = true) {
+    std::lock_guard<std::mutex> lk(rooms_mtx);
+    auto it = rooms.find(name);
+    if (it != rooms.end()) return it->second.get();
+    if (!create || rooms.size() >= MAX_ROOMS) return nullptr;
+
+    auto room = std::make_unique<Room>();
+    room->name = name;
+    const std::string dir = std::string(HISTORY_DIR) + "/" + name;
+    if (room->history.open(dir)) {
+        room->retention = load_retention(dir);
+        load_recent(*room);
+        room->search.open(room->history, dir + "/index");
+        std::cout << "Room " << name << ": " << (room->history.durable_seq() - room->history.first_seq())
+                  << " messages in " << dir << "\n";
+    } else {
+        std::cerr << "Cannot open message history in " << dir << ", messages will not be kept\n";
+    }
+    Room* result = room.get();
+    rooms.emplace(name, std::move(room));
+    return result;
+}
+
+// Direct replies go out under the lock of the client's room, like its broadcasts, so the
+// two never interleave on the socket
+void reply(Room& current, SOCKET client, const std::vector<std::string_view>& spans) {
+    std::lock_guard<std::mutex> lk(current.mtx);
+    send_spans(client, spans);
+}
+
+// Removes `client` from the room. A signed-in user's cursor moves past everything the room
+// has fanned out and synced so far. Messages still waiting for their group commit are sent
+// again on the next sign-in: after a crash the log reuses their seqs for new messages, which
+// a cursor past them would skip.
+void leave_room(SOCKET client, Room& room, const std::string& user) {
+    uint64_t durable_seq;
+    {
+        std::lock_guard<std::mutex> lk(room.mtx);
+        room.members.erase(std::remove(room.members.begin(), room.members.end(), client), room.members.end());
+        durable_seq = room.history.durable_seq();
+    }
+    if (!user.empty() && durable_seq != 0) {
+        cursors.advance(user, room.name, durable_seq);
+    }
+}
+
+// Narrows a missed range [from, end) of `room` to stored messages, keeping the newest
+// MAX_MISSED_MESSAGES; false if nothing is left
+bool clamp_missed(Room& room, uint64_t& from, uint64_t& end) {
+    end = std::min(end, room.history.durable_seq());
+    from = std::max(from, room.history.first_seq());
+    if (end > from + MAX_MISSED_MESSAGES) from = end - MAX_MISSED_MESSAGES;
+    return from < end;
+}
+
+// Streams the stored messages in [from, end) of `room`, whose MISSED header has been sent, a
+// batch per write under the client's room lock so live frames can go out in between; then
+// moves the user's cursor past them. Returns how many messages were sent, not counting DEL
+// frames.
+size_t send_missed(SOCKET client, Room& current, const std::string& user, Room& room, uint64_t from, uint64_t end) {
+    size_t sent = 0;
+    std::vector<MessageLog::Entry> entries;
+    std::vector<MessageView> frames;
+    std::vector<std::string_view> spans;
+    while (from < end) {
+        entries.clear();
+        frames.clear();
+        spans.clear();
+        if (room.history.read(from, (size_t)std::min<uint64_t>(end - from, MISSED_BATCH), entries) == 0) break;
+        trim_to_budget(entries, false);
+        from = entries.back().seq + 1;
+        format_entries(room.name, entries, frames);
+        for (const MessageView& frame : frames) spans.push_back(frame.text);
+        reply(current, client, spans);
+        sent += (size_t)std::count_if(entries.begin(), entries.end(),
+                                      [](const MessageLog::Entry& entry) { return !entry.deleted; });
+    }
+    cursors.advance(user, room.name, from);
+    return sent;
+}
+
+// Moves `client` into `to`: the recent frames and the confirmation arrive in one write,
+// and live frames follow without a gap because the room lock is held throughout. A signed-in
+// user who follows `to` is then sent what they missed before the recent frames, announced
+// ahead of them. Returns the first seq the client was sent as a member.
+uint64_t join_room(SOCKET client, Room* from, Room& to, bool announce, const std::string& user) {
+    if (from) {
+        leave_room(client, *from, user);
+    }
+
+    bool follows = false;
+    uint64_t missed_from = 0;
+    if (!user.empty()) {
+        const DeliveryCursors::RoomCursors followed = cursors.get(user);
+        auto cursor = followed.find(to.name);
+        follows = cursor != followed.end();
+        if (follows) missed_from = cursor->second;
+    }
+
+    const std::string notice = "[SYSTEM] Joined " + to.name + "\n";
+    std::string header;
+    std::vector<std::string_view> spans;
+    uint64_t joined_at;
+    uint64_t missed_end;
+    {
+        std::lock_guard<std::mutex> lk(to.mtx);
+        to.members.push_back(client);
+        joined_at = to.recent.size() > 0 ? to.recent.first_seq() : to.history.next_seq();
+        missed_end = joined_at;
+        if (follows && clamp_missed(to, missed_from, missed_end)) {
+            header = format_missed_frame(to.name, missed_from, missed_end - 1) + "\n";
+            spans.push_back(header);
+        }
+        to.recent.spans(spans);
+        if (announce) spans.push_back(notice);
+        send_spans(client, spans);
+    }
+
+    if (!header.empty()) {
+        send_missed(client, to, user, to, missed_from, missed_end);
+    }
+    // Like leave_room(), never past what is durable
+    const uint64_t cursor = std::min(joined_at, to.history.durable_seq());
+    if (!user.empty() && cursor != 0) {
+        cursors.advance(user, to.name, cursor);
+    }
+    return joined_at;
+}
+
+// Persists the lines and fans them out to the other members in one send each; the sender
+// gets an ACK with the seqs its lines were given instead of an echo
+void broadcast(Room& room, SOCKET except, const std::string& sender, const std::vector<std::string_view>& lines) {
+    if (lines.empty()) return;
+
+    size_t bytes = 0;
+    for (std::string_view line : lines) bytes += MAX_FRAME_HEADER + line.size() + 1;
+    BufferRef buffer = BufferPool::instance().acquire(bytes);
+    char* pos = buffer->data();
+    const int64_t timestamp_ms = now_ms();
+
+    std::lock_guard<std::mutex> lk(room.mtx);
+    uint64_t first_seq = 0;
+    uint64_t last_seq = 0;
+    for (std::string_view line : lines) {
+        // Only queues; the log syncs in batches. Seq order matches fan-out order under the room lock.
+        const uint64_t seq = room.history.append(sender, line, timestamp_ms);
+        if (seq != 0) {
+            if (first_seq == 0) first_seq = seq;
+            last_seq = seq;
+        } else if (room.recent.first_seq() != 0) {
+            // History stopped (a failed write): the ring goes unsequenced, like a room without one
+            room.recent.clear();
+        }
+
+        char* frame = pos;
+        pos += format_chat_header(pos, room.name, seq, timestamp_ms, sender);
+        std::memcpy(pos, line.data(), line.size());
+        pos += line.size();
+        *pos++ = '\n';
+        MessageView view{std::string_view(frame, (size_t)(pos - frame)), buffer};
+        view.seq = seq;
+        room.recent.push(view);
+    }
+    const std::string_view frames(buffer->data(), (size_t)(pos - buffer->data()));
+    std::cout << "Broadcasting to " << room.name << ": " << frames;
+    for (SOCKET s : room.members) {
         if (s == except) continue;
-        int result = send(s, msg.c_str(), (int)msg.size(), 0);
+        int result = send(s, frames.data(), (int)frames.size(), 0);
         if (result == SOCKET_ERROR) {
             int err = WSAGetLastError();
             std::cerr << "Send error to client (error: " << err << "), may need to disconnect\n";
         }
     }
+
+    if (first_seq != 0) {
+        const std::string ack = "ACK " + room.name + " " + std::to_string(first_seq) + " " +
+                                std::to_string(last_seq) + "\n";
+        send_spans(except, {ack});
+    }
+}
+
+// Serves a gap the client detected: the newest part from the replay ring, older messages
+// from the log. Frames go out in seq order in one write.
+void resend(SOCKET client, Room& current, std::string_view line) {
+    std::string_view room_name;
+    uint64_t first_seq;
+    uint64_t last_seq;
+    Room* room = nullptr;
+    if (parse_resend_command(line, room_name, first_seq, last_seq)) {
+        room = find_room(std::string(room_name), false);
+    }
+    if (!room) {
+        reply(current, client, {"[SYSTEM] Usage: /resend <room> <first_seq> <last_seq>\n"});
+        return;
+    }
+    last_seq = std::min(last_seq, first_seq + MAX_RESEND - 1);
+
+    std::vector<MessageView> recent;
+    uint64_t recent_first;
+    {
+        std::lock_guard<std::mutex> lk(room->mtx);
+        recent_first = room->recent.first_seq();
+        room->recent.frames(first_seq, last_seq, recent);
+    }
+
+    std::vector<MessageView> frames;
+    const uint64_t stored_last = recent_first == 0 ? last_seq : std::min(last_seq, recent_first - 1);
+    if (first_seq <= stored_last) {
+        std::vector<MessageLog::Entry> entries;
+        room->history.read(first_seq, (size_t)(stored_last - first_seq + 1), entries);
+        trim_to_budget(entries, false);
+        format_entries(room->name, entries, frames);
+    }
+    frames.insert(frames.end(), recent.begin(), recent.end());
+
+    std::vector<std::string_view> spans;
+    for (const MessageView& frame : frames) spans.push_back(frame.text);
+    reply(current, client, spans);
+}
+
+// Sends stored messages as HIS frames for request `id`, then HEND, in one write
+void send_page(SOCKET client, Room& current, Room& room, uint64_t id, const std::vector<MessageLog::Entry>& entries) {
+    const std::string id_text = std::to_string(id);
+    std::vector<MessageView> frames;
+    format_entries(room.name, entries, frames, "HIS " + id_text + " ");
+    const std::string end_frame = "HEND " + id_text + " " + room.name + " " + std::to_string(frames.size()) + " " +
+                                  std::to_string(room.history.first_seq()) + "\n";
+
+    std::vector<std::string_view> spans;
+    for (const MessageView& frame : frames) spans.push_back(frame.text);
+    spans.push_back(end_frame);
+    reply(current, client, spans);
+}
+
+// Serves a page of stored history for /history, oldest first, followed by HEND in the same write.
+// Lookups go through the log's sparse seq and time indexes, so no page scans the room.
+void history(SOCKET client, Room& current, std::string_view line) {
+    HistoryQuery query;
+    Room* room = nullptr;
+    if (parse_history_command(line, query)) {
+        room = find_room(std::string(query.room), false);
+    }
+    if (!room) {
+        reply(current, client, {"[SYSTEM] Usage: /history <id> <room> before <seq> <count> | "
+                                "/history <id> <room> between <from_ms> <to_ms> <count>\n"});
+        return;
+    }
+
+    MessageLog& log = room->history;
+    const uint64_t count = std::min(query.count, MAX_HISTORY_PAGE);
+    uint64_t first;
+    uint64_t end;
+    if (query.by_time) {
+        first = log.seq_at_time(query.from_ms);
+        end = std::min(log.seq_at_time(query.to_ms), first + count);
+    } else {
+        end = query.before_seq == 0 ? log.durable_seq() : std::min(query.before_seq, log.durable_seq());
+        first = std::max(log.first_seq(), end > count ? end - count : 0);
+    }
+
+    std::vector<MessageLog::Entry> entries;
+    if (first < end) {
+        log.read(first, (size_t)(end - first), entries);
+        trim_to_budget(entries, !query.by_time);  // a "before" page must stay adjacent to before_seq
+    }
+
+    send_page(client, current, *room, query.id, entries);
+}
+
+// Serves /search from the room's full-text index: the newest live matches below before_seq,
+// sent oldest first like a /history page. Erased messages are left out rather than sent as
+// DEL placeholders, which would tell the client an erased message had matched.
+void search(SOCKET client, Room& current, std::string_view line) {
+    SearchQuery query;
+    Room* room = nullptr;
+    if (parse_search_command(line, query)) {
+        room = find_room(std::string(query.room), false);
+    }
+    if (!room) {
+        reply(current, client, {"[SYSTEM] Usage: /search <id> <room> <before_seq> <count> <words>\n"});
+        return;
+    }
+
+    // The index still holds postings of erased messages, so keep asking for older matches
+    // until the page has enough live ones or the index runs out
+    const size_t count = (size_t)std::min(query.count, MAX_HISTORY_PAGE);
+    uint64_t before_seq = query.before_seq;
+    std::vector<uint64_t> seqs;
+    std::vector<MessageLog::Entry> entries;  // newest first until reversed below
+    std::vector<MessageLog::Entry> scratch;
+    while (entries.size() < count) {
+        const size_t wanted = count - entries.size();
+        seqs.clear();
+        room->search.search(query.text, before_seq, wanted, seqs);
+        for (uint64_t seq : seqs) {
+            // Retention may have dropped the match; read() then returns the oldest survivor instead
+            scratch.clear();
+            if (room->history.read(seq, 1, scratch) == 0 || scratch.back().seq != seq || scratch.back().deleted) {
+                continue;
+            }
+            entries.push_back(std::move(scratch.back()));
+        }
+        if (seqs.size() < wanted) break;
+        before_seq = seqs.back();
+    }
+    std::reverse(entries.begin(), entries.end());
+    trim_to_budget(entries, true);
+    send_page(client, current, *room, query.id, entries);
+}
+
+// Erases one of the client's own messages: the log tombstones it (compaction reclaims it
+// later) and the replay ring swaps its frame for a DEL frame. Clients that already received
+// it keep their copy.
+void erase_message(SOCKET client, Room& current, const std::string& sender, std::string_view line) {
+    std::string_view room_name;
+    uint64_t seq = 0;
+    Room* room = nullptr;
+    if (parse_delete_command(line, room_name, seq)) {
+        room = find_room(std::string(room_name), false);
+    }
+    bool erased = false;
+    std::vector<MessageLog::Entry> entries;
+    if (room) {
+        room->history.read(seq, 1, entries);
+        erased = !entries.empty() && entries[0].seq == seq && !entries[0].deleted && entries[0].sender == sender &&
+                 room->history.erase(seq);
+    }
+    if (!erased) {
+        reply(current, client, {"[SYSTEM] Usage: /delete <room> <seq> (one of your own stored messages)\n"});
+        return;
+    }
+
+    entries[0].deleted = true;
+    std::vector<MessageView> placeholder;
+    format_entries(room->name, entries, placeholder);
+    {
+        std::lock_guard<std::mutex> lk(room->mtx);
+        room->recent.replace(placeholder[0]);
+    }
+    const std::string notice = "[SYSTEM] Deleted " + std::to_string(seq) + " in " + room->name + "\n";
+    reply(current, client, {notice});
+}
+
+// Signs the connection in as a user: it is sent what the user missed in every room they
+// follow, and follows `current` from `joined_at` (see join_room) on. Later messages carry
+// the user name instead of the address. There is no authentication.
+bool sign_in(SOCKET client, Room& current, uint64_t joined_at, std::string_view line, std::string& user) {
+    std::string_view name;
+    if (!user.empty() || !parse_user_command(line, name) || !valid_name(name)) {
+        reply(current, client, {"[SYSTEM] Usage: /user <name> (letters, digits, - and _, at most 32; once per connection)\n"});
+        return false;
+    }
+    user = std::string(name);
+
+    size_t missed = 0;
+    for (const auto& cursor : cursors.get(user)) {
+        Room* room = valid_name(cursor.first) ? find_room(cursor.first) : nullptr;
+        if (!room || !room->history.is_open()) continue;
+        // The current room's newer messages were already sent to this connection as a member
+        uint64_t from = cursor.second;
+        uint64_t end = room == &current ? joined_at : room->history.next_seq();
+        if (!clamp_missed(*room, from, end)) continue;
+        const std::string header = format_missed_frame(room->name, from, end - 1) + "\n";
+        reply(current, client, {header});
+        missed += send_missed(client, current, user, *room, from, end);
+    }
+    const uint64_t joined_cursor = std::min(joined_at, current.history.durable_seq());
+    if (joined_cursor != 0) {
+        cursors.advance(user, current.name, joined_cursor);
+    }
+
+    const std::string notice = "[SYSTEM] Signed in as " + user + ", " + std::to_string(missed) + " missed messages\n";
+    reply(current, client, {notice});
+    return true;
+}
+
+// Retention and compaction for every room, one room at a time, at background CPU and I/O
+// priority so client threads and fan-out never wait behind it
+void maintain_history() {
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+    std::unique_lock<std::mutex> lk(maintenance_mtx);
+    while (!maintenance_cv.wait_for(lk, MAINTENANCE_INTERVAL, [] { return maintenance_stopping; })) {
+        lk.unlock();
+        std::vector<Room*> snapshot;
+        {
+            std::lock_guard<std::mutex> rooms_lk(rooms_mtx);
+            for (auto& entry : rooms) snapshot.push_back(entry.second.get());
+        }
+        for (Room* room : snapshot) {
+            if (!room->history.is_open()) continue;
+            const size_t expired = room->history.enforce_retention(room->retention, now_ms());
+            uint64_t reclaimed = 0;
+            while (uint64_t bytes = room->history.compact(COMPACTION_BYTES_PER_SECOND)) {
+                reclaimed += bytes;
+                std::lock_guard<std::mutex> stop_lk(maintenance_mtx);
+                if (maintenance_stopping) break;
+            }
+            if (expired > 0 || reclaimed > 0) {
+                std::cout << "Room " << room->name << ": " << expired << " expired segments deleted, " << reclaimed
+                          << " bytes of erased messages compacted away\n";
+            }
+        }
+        lk.lock();
+    }
+}
+
+// "/name" on its own or followed by arguments; other lines starting with '/' are chat
+bool is_command(std::string_view line, std::string_view name) {
+    return line.size() > name.size() && line[0] == '/' && line.substr(1, name.size()) == name &&
+           (line.size() == name.size() + 1 || line[name.size() + 1] == ' ');
 }
 
 void handle_client(SOCKET client) {
     char buf[1024];
+    std::string sender = peer_name(client);  // the user name once signed in
+    std::string user;                        // set by /user
+    std::string partial;  // bytes of a line not yet terminated
+    std::vector<std::string_view> lines;
+    bool checksums = false;  // set by /checksums
     std::cout << "Client connected\n";
-    
-    while (true) {
+
+    Room* room = find_room(DEFAULT_ROOM);
+    uint64_t joined_at = 0;
+    if (room) {
+        joined_at = join_room(client, nullptr, *room, false, user);
+    }
+
+    while (room) {
         int n = recv(client, buf, (int)sizeof(buf) - 1, 0);
         if (n <= 0) {
             if (n == 0) {
@@ -41,17 +635,79 @@ void handle_client(SOCKET client) {
             break;
         }
         buf[n] = '\0';
-        std::string msg = std::string(buf);
-        std::cout << "Broadcasting: " << msg;
-        broadcast(msg, client);
+        partial.append(buf, (size_t)n);
+
+        // Split off complete lines; runs of chat lines are broadcast together, commands in order
+        size_t begin = 0;
+        for (;;) {
+            size_t newline = partial.find('\n', begin);
+            if (newline == std::string::npos) {
+                if (partial.size() - begin < MAX_LINE) break;
+                newline = begin + MAX_LINE;
+            }
+            size_t end = newline;
+            if (end > begin && partial[end - 1] == '\r') --end;
+            std::string_view line = std::string_view(partial).substr(begin, end - begin);
+            begin = newline < partial.size() && partial[newline] == '\n' ? newline + 1 : newline;
+            if (line.empty()) continue;
+            if (checksums && !strip_frame_checksum(line)) {
+                reply(*room, client, {"[SYSTEM] Dropped a line with a bad checksum\n"});
+                continue;
+            }
+
+            const bool join = is_command(line, "join");
+            if (!join && !is_command(line, "resend") && !is_command(line, "history") && !is_command(line, "search") &&
+                !is_command(line, "delete") && !is_command(line, "checksums") && !is_command(line, "user")) {
+                lines.push_back(line);
+                continue;
+            }
+            broadcast(*room, client, sender, lines);
+            lines.clear();
+
+            if (is_command(line, "resend")) {
+                resend(client, *room, line);
+                continue;
+            }
+            if (is_command(line, "history")) {
+                history(client, *room, line);
+                continue;
+            }
+            if (is_command(line, "search")) {
+                search(client, *room, line);
+                continue;
+            }
+            if (is_command(line, "delete")) {
+                erase_message(client, *room, sender, line);
+                continue;
+            }
+            if (is_command(line, "user")) {
+                if (sign_in(client, *room, joined_at, line, user)) sender = user;
+                continue;
+            }
+            if (is_command(line, "checksums")) {
+                checksums = true;
+                reply(*room, client, {"[SYSTEM] Frame checksums on\n"});
+                continue;
+            }
+            const std::string target(line.substr(std::min<size_t>(line.size(), 6)));
+            Room* next = valid_name(target) ? find_room(target) : nullptr;
+            if (next && next != room) {
+                joined_at = join_room(client, room, *next, true, user);
+                room = next;
+            } else if (!next) {
+                reply(*room, client, {"[SYSTEM] Usage: /join <room> (letters, digits, - and _, at most 32)\n"});
+            }
+        }
+        broadcast(*room, client, sender, lines);
+        lines.clear();
+        partial.erase(0, begin);
     }
 
-    closesocket(client);
-    {
-        std::lock_guard<std::mutex> lk(clients_mtx);
-        clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+    if (room) {
+        leave_room(client, *room, user);
     }
-    std::cout << "Client removed. Active clients: " << clients.size() << "\n";
+    closesocket(client);
+    std::cout << "Client removed. Active clients: " << --client_count << "\n";
 }
 
 int main() {
@@ -90,6 +746,13 @@ int main() {
         return 1;
     }
 
+    // Open (and recover) the default room before taking connections
+    find_room(DEFAULT_ROOM);
+    if (!cursors.open(USERS_DIR)) {
+        std::cerr << "Offline delivery is off: cannot open " << USERS_DIR << "\n";
+    }
+    std::thread maintenance(maintain_history);
+
     std::cout << "Server listening on port " << PORT << "\n";
 
     while (true) {
@@ -98,15 +761,24 @@ int main() {
             std::cerr << "accept() failed\n";
             break;
         }
-        {
-            std::lock_guard<std::mutex> lk(clients_mtx);
-            clients.push_back(client);
-        }
-        std::cout << "New client connected. Total clients: " << clients.size() << "\n";
+        std::cout << "New client connected. Total clients: " << ++client_count << "\n";
         std::thread(handle_client, client).detach();
     }
 
     closesocket(listen_sock);
+    {
+        std::lock_guard<std::mutex> lk(maintenance_mtx);
+        maintenance_stopping = true;
+    }
+    maintenance_cv.notify_all();
+    maintenance.join();
+    {
+        std::lock_guard<std::mutex> lk(rooms_mtx);
+        for (auto& entry : rooms) {
+            entry.second->search.close();
+            entry.second->history.close();  // syncs whatever is still queued
+        }
+    }
     WSACleanup();
     return 0;
 }
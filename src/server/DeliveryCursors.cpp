@@ -0,0 +1,105 @@
+#include "server/DeliveryCursors.hpp"
+#include "storage/AppendFile.hpp"
+#include "storage/Crc32c.hpp"
+#include "storage/MappedFile.hpp"
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+// File layout: per room a u8 name length, the name and the u64 cursor, then a u32 CRC-32C
+// of everything before it
+static constexpr size_t CURSOR_SIZE = 8;
+static constexpr size_t CRC_SIZE = 4;
+
+bool DeliveryCursors::open(const std::string& directory) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "[DeliveryCursors] Cannot create " << directory << ": " << error.message() << "\n";
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    directory_ = directory;
+    users_.clear();
+    return true;
+}
+
+DeliveryCursors::RoomCursors DeliveryCursors::get(const std::string& user) {
+    const std::shared_ptr<User> entry = find_user(user);
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    load(user, *entry);
+    return entry->cursors;
+}
+
+bool DeliveryCursors::advance(const std::string& user, const std::string& room, uint64_t next_seq) {
+    const std::shared_ptr<User> entry = find_user(user);
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    load(user, *entry);
+    auto it = entry->cursors.find(room);
+    if (it != entry->cursors.end() && it->second >= next_seq) return true;
+    entry->cursors[room] = next_seq;
+    return save(user, entry->cursors);
+}
+
+std::shared_ptr<DeliveryCursors::User> DeliveryCursors::find_user(const std::string& user) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::shared_ptr<User>& entry = users_[user];
+    if (!entry) entry = std::make_shared<User>();
+    return entry;
+}
+
+void DeliveryCursors::load(const std::string& user, User& entry) const {
+    if (entry.loaded) return;
+    entry.loaded = true;
+    RoomCursors& cursors = entry.cursors;
+    const std::string file_path = path(user);
+    std::error_code error;
+    if (directory_.empty() || !std::filesystem::exists(file_path, error)) return;
+
+    MappedFile file;
+    uint32_t crc = 0;
+    if (file.open(file_path) && file.size() >= CRC_SIZE) {
+        std::memcpy(&crc, file.data() + file.size() - CRC_SIZE, CRC_SIZE);
+    }
+    if (!file.is_open() || file.size() < CRC_SIZE || crc32c(file.data(), file.size() - CRC_SIZE) != crc) {
+        std::cerr << "[DeliveryCursors] Ignoring damaged " << file_path << "\n";
+        return;
+    }
+
+    const char* pos = file.data();
+    const char* end = file.data() + file.size() - CRC_SIZE;
+    while (pos < end) {
+        const size_t name_size = (unsigned char)*pos++;
+        if ((size_t)(end - pos) < name_size + CURSOR_SIZE) break;
+        uint64_t next_seq;
+        std::memcpy(&next_seq, pos + name_size, CURSOR_SIZE);
+        cursors[std::string(pos, name_size)] = next_seq;
+        pos += name_size + CURSOR_SIZE;
+    }
+}
+
+bool DeliveryCursors::save(const std::string& user, const RoomCursors& cursors) const {
+    if (directory_.empty()) return false;
+
+    std::string data;
+    for (const auto& entry : cursors) {
+        if (entry.first.size() > 0xFF) continue;
+        data.push_back((char)entry.first.size());
+        data += entry.first;
+        data.append(reinterpret_cast<const char*>(&entry.second), CURSOR_SIZE);
+    }
+    const uint32_t crc = crc32c(data.data(), data.size());
+    data.append(reinterpret_cast<const char*>(&crc), CRC_SIZE);
+
+    // A crash leaves either the old cursors or the new ones
+    const std::string file_path = path(user);
+    if (!write_file_atomically(file_path, data.data(), data.size())) {
+        std::cerr << "[DeliveryCursors] Cannot write " << file_path << "\n";
+        return false;
+    }
+    return true;
+}
+
+std::string DeliveryCursors::path(const std::string& user) const {
+    return (std::filesystem::path(directory_) / (user + ".cursors")).string();
+}
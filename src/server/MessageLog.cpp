@@ -0,0 +1,958 @@
+#include "server/MessageLog.hpp"
+#include "storage/Crc32c.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <thread>
+
+MessageLog::MessageLog()
+    : next_seq_(0), open_(false), stopping_(false), write_seq_(0), max_time_(INT64_MIN), write_failed_(false),
+      durable_seq_(0) {
+}
+
+MessageLog::~MessageLog() {
+    close();
+}
+
+bool MessageLog::open(const std::string& directory) {
+    close();
+    directory_ = directory;
+
+    if (!recover()) {
+        close();
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        next_seq_ = write_seq_;
+        open_ = true;
+        stopping_ = false;
+    }
+    durable_seq_.store(write_seq_);
+    writer_ = std::thread(&MessageLog::writer_loop, this);
+    return true;
+}
+
+void MessageLog::close() {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        open_ = false;
+        stopping_ = true;
+    }
+    pending_cv_.notify_all();
+    space_cv_.notify_all();
+    if (writer_.joinable()) {
+        writer_.join();  // drains pending_ first
+    }
+
+    active_file_.close();
+    active_.reset();
+    tombstone_file_.close();
+    expired_files_.clear();
+    replaced_files_.clear();
+    new_sparse_.clear();
+    new_sparse_time_.clear();
+    max_time_ = INT64_MIN;
+    {
+        std::lock_guard<std::mutex> lock(segments_mutex_);
+        segments_.clear();
+        tombstones_.clear();
+    }
+    pending_.clear();
+    next_seq_ = 0;
+    write_seq_ = 0;
+    write_failed_ = false;
+    durable_seq_.store(0);
+}
+
+bool MessageLog::is_open() const {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    return open_;
+}
+
+uint64_t MessageLog::first_seq() const {
+    std::lock_guard<std::mutex> lock(segments_mutex_);
+    return segments_.empty() ? 0 : segments_.front()->base_seq;
+}
+
+uint64_t MessageLog::durable_seq() const {
+    return durable_seq_.load(std::memory_order_acquire);
+}
+
+uint64_t MessageLog::next_seq() const {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    return open_ ? next_seq_ : 0;
+}
+
+bool MessageLog::wait_durable(uint64_t seq, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(segments_mutex_);
+    return durable_cv_.wait_for(lock, timeout, [this, seq] { return durable_seq() > seq; });
+}
+
+uint64_t MessageLog::append(std::string_view sender, std::string_view text, int64_t timestamp_ms) {
+    sender = sender.substr(0, MAX_SENDER_SIZE);
+    const uint32_t body_size = (uint32_t)(sender.size() + text.size());
+    const uint16_t sender_size = (uint16_t)sender.size();
+    const uint16_t flags = 0;
+    const uint32_t reserved = 0;
+
+    std::unique_lock<std::mutex> lock(pending_mutex_);
+    // A client thread is only held up here if the disk has fallen far behind
+    space_cv_.wait(lock, [this] { return pending_.size() < MAX_PENDING_BYTES || stopping_; });
+    if (!open_ || write_failed_) return 0;
+
+    // Encoded under the lock so records queue in sequence order
+    const uint64_t seq = next_seq_++;
+    char header[RECORD_HEADER_SIZE];
+    std::memcpy(header + 4, &body_size, sizeof(body_size));
+    std::memcpy(header + 8, &seq, sizeof(seq));
+    std::memcpy(header + 16, &timestamp_ms, sizeof(timestamp_ms));
+    std::memcpy(header + 24, &sender_size, sizeof(sender_size));
+    std::memcpy(header + 26, &flags, sizeof(flags));
+    std::memcpy(header + 28, &reserved, sizeof(reserved));
+    uint32_t crc = crc32c(header + 4, RECORD_HEADER_SIZE - 4);
+    crc = crc32c(sender.data(), sender.size(), crc);
+    crc = crc32c(text.data(), text.size(), crc);
+    std::memcpy(header, &crc, sizeof(crc));
+
+    const bool was_empty = pending_.empty();
+    pending_.append(header, sizeof(header));
+    pending_.append(sender.data(), sender.size());
+    pending_.append(text.data(), text.size());
+    lock.unlock();
+
+    if (was_empty) {
+        pending_cv_.notify_one();
+    }
+    return seq;
+}
+
+size_t MessageLog::read(uint64_t from_seq, size_t max_count, std::vector<Entry>& out) {
+    size_t added = 0;
+    std::vector<uint64_t> erased;
+    while (added < max_count) {
+        std::shared_ptr<const MappedFile> mapping;
+        uint64_t at;
+        uint64_t offset;
+        uint64_t end_seq;
+        {
+            std::lock_guard<std::mutex> lock(segments_mutex_);
+            if (segments_.empty()) break;
+            from_seq = std::max(from_seq, segments_.front()->base_seq);
+            auto it = std::upper_bound(segments_.begin(), segments_.end(), from_seq,
+                                       [](uint64_t seq, const std::shared_ptr<Segment>& segment) {
+                                           return seq < segment->base_seq;
+                                       });
+            Segment& segment = **(it - 1);
+            if (from_seq >= segment.end_seq) break;
+
+            // A mapping made before the latest commit does not cover it yet
+            if (!segment.mapping || segment.mapping->size() < segment.size) {
+                auto fresh = std::make_shared<MappedFile>();
+                if (!fresh->open(segment.path) || fresh->size() < segment.size) {
+                    std::cerr << "[MessageLog] Cannot map " << segment.path << "\n";
+                    break;
+                }
+                segment.mapping = std::move(fresh);
+            }
+            mapping = segment.mapping;
+            const uint64_t k = (from_seq - segment.base_seq) / SPARSE_EVERY;
+            at = segment.base_seq + k * SPARSE_EVERY;
+            offset = segment.sparse[k];
+            end_seq = segment.end_seq;
+
+            // Erased since the segment was last compacted
+            erased.clear();
+            for (auto t = tombstones_.lower_bound(from_seq);
+                 t != tombstones_.end() && *t < end_seq && *t - from_seq < max_count - added; ++t) {
+                erased.push_back(*t);
+            }
+        }
+
+        // Walk forward from the nearest indexed record; everything below end_seq is durable
+        const char* data = mapping->data();
+        while (at < end_seq && added < max_count) {
+            uint32_t body_size;
+            uint16_t sender_size;
+            std::memcpy(&body_size, data + offset + 4, sizeof(body_size));
+            if (at >= from_seq) {
+                uint16_t flags;
+                Entry entry;
+                entry.seq = at;
+                std::memcpy(&entry.timestamp_ms, data + offset + 16, sizeof(entry.timestamp_ms));
+                std::memcpy(&sender_size, data + offset + 24, sizeof(sender_size));
+                std::memcpy(&flags, data + offset + 26, sizeof(flags));
+                entry.deleted = (flags & FLAG_DELETED) != 0 || std::binary_search(erased.begin(), erased.end(), at);
+                if (!entry.deleted) {
+                    const char* body = data + offset + RECORD_HEADER_SIZE;
+                    entry.sender = std::string_view(body, sender_size);
+                    entry.text = std::string_view(body + sender_size, body_size - sender_size);
+                }
+                entry.mapping = mapping;
+                out.push_back(std::move(entry));
+                ++added;
+            }
+            offset += RECORD_HEADER_SIZE + body_size;
+            ++at;
+        }
+        if (at < end_seq) break;
+        from_seq = at;  // continue in the next segment
+    }
+    return added;
+}
+
+uint64_t MessageLog::seq_at_time(int64_t timestamp_ms) {
+    uint64_t start;
+    int64_t newest;
+    {
+        std::lock_guard<std::mutex> lock(segments_mutex_);
+        // Sparse times never decrease, across segments too; an empty (just rolled) segment is last
+        auto it = std::partition_point(segments_.begin(), segments_.end(), [=](const std::shared_ptr<Segment>& segment) {
+            return !segment->sparse_time.empty() && segment->sparse_time.front() < timestamp_ms;
+        });
+        if (it == segments_.begin()) {
+            return segments_.empty() ? durable_seq() : segments_.front()->base_seq;
+        }
+        const Segment& segment = **(it - 1);
+        auto point = std::partition_point(segment.sparse_time.begin(), segment.sparse_time.end(),
+                                          [=](int64_t time) { return time < timestamp_ms; });
+        // The indexed record before `point` is still too old; the answer is within the next SPARSE_EVERY
+        const size_t k = (size_t)(point - segment.sparse_time.begin()) - 1;
+        start = segment.base_seq + k * SPARSE_EVERY + 1;
+        newest = segment.sparse_time[k];
+    }
+
+    std::vector<Entry> entries;
+    read(start, SPARSE_EVERY, entries);
+    for (const Entry& entry : entries) {
+        newest = std::max(newest, entry.timestamp_ms);
+        if (newest >= timestamp_ms) return entry.seq;
+    }
+    return entries.empty() ? start : entries.back().seq + 1;
+}
+
+bool MessageLog::recover() {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    fs::create_directories(directory_, error);
+    if (error) {
+        std::cerr << "[MessageLog] Cannot create " << directory_ << ": " << error.message() << "\n";
+        return false;
+    }
+
+    // Segment files are named after their first sequence number
+    std::vector<uint64_t> bases;
+    std::vector<uint64_t> compacted;
+    for (const auto& item : fs::directory_iterator(directory_, error)) {
+        const std::string name = item.path().filename().string();
+        const bool numbered = name.size() == 24 &&
+            std::all_of(name.begin(), name.begin() + 20, [](char c) { return c >= '0' && c <= '9'; });
+        if (numbered && name.compare(20, 4, ".log") == 0) {
+            bases.push_back(std::stoull(name.substr(0, 20)));
+        } else if (numbered && name.compare(20, 4, ".cmp") == 0) {
+            compacted.push_back(std::stoull(name.substr(0, 20)));
+        } else if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+            fs::remove(item.path(), error);  // a checkpoint or compaction cut short
+        }
+    }
+    if (error) {
+        std::cerr << "[MessageLog] Cannot list " << directory_ << ": " << error.message() << "\n";
+        return false;
+    }
+
+    // A compacted copy that had not replaced its original yet: compaction only ever shrinks a
+    // segment, so the smaller file is the newer one
+    for (uint64_t base : compacted) {
+        const std::string log_path = segment_path(base);
+        const std::string copy_path = segment_path(base, ".cmp");
+        if (!fs::exists(log_path, error)) {
+            bases.push_back(base);
+        } else if (fs::file_size(copy_path, error) >= fs::file_size(log_path, error)) {
+            fs::remove(copy_path, error);
+            continue;
+        } else {
+            fs::remove(log_path, error);
+        }
+        if (!error) fs::rename(copy_path, log_path, error);
+        if (error) {
+            std::cerr << "[MessageLog] Cannot replace " << log_path << " with its compacted copy: " << error.message()
+                      << "\n";
+            return false;
+        }
+    }
+    std::sort(bases.begin(), bases.end());
+
+    // Sealed segments come back from their checkpoints; the rest (normally only the last one)
+    // are verified record by record, in parallel since each scan is independent
+    std::vector<std::shared_ptr<Segment>> found;
+    std::vector<size_t> unverified;
+    std::vector<char> scanned(bases.size(), 0);
+    for (size_t i = 0; i < bases.size(); ++i) {
+        auto segment = std::make_shared<Segment>();
+        segment->base_seq = bases[i];
+        segment->end_seq = bases[i];
+        segment->size = 0;
+        segment->max_time = INT64_MIN;
+        segment->path = segment_path(bases[i]);
+        if (i + 1 == bases.size() || !load_checkpoint(*segment)) {
+            unverified.push_back(i);
+            scanned[i] = 1;
+        }
+        found.push_back(std::move(segment));
+    }
+
+    std::vector<char> torn(found.size(), 0);
+    std::vector<char> failed(found.size(), 0);
+    std::atomic<size_t> next{0};
+    auto scan_worker = [&]() {
+        for (size_t k; (k = next++) < unverified.size();) {
+            const size_t i = unverified[k];
+            bool segment_torn = false;
+            failed[i] = !scan_segment(*found[i], segment_torn);
+            torn[i] = segment_torn;
+        }
+    };
+    const size_t threads = std::min<size_t>(unverified.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> scanners;
+    for (size_t t = 1; t < threads; ++t) {
+        scanners.emplace_back(scan_worker);
+    }
+    scan_worker();
+    for (std::thread& scanner : scanners) {
+        scanner.join();
+    }
+
+    // Everything after the first torn record or missing range is unreachable by sequence number
+    max_time_ = INT64_MIN;
+    for (size_t i = 0; i < found.size(); ++i) {
+        if (failed[i]) return false;
+        Segment& segment = *found[i];
+        const bool contiguous = segments_.empty() || segment.base_seq == segments_.back()->end_seq;
+        if (contiguous) {
+            // A scan only sees its own segment; carry the running maximum over from earlier ones
+            for (int64_t& time : segment.sparse_time) time = std::max(time, max_time_);
+            max_time_ = std::max(max_time_, segment.max_time);
+            segment.max_time = max_time_;
+            if (scanned[i] && !torn[i] && i + 1 < found.size()) {
+                write_checkpoint(segment);
+            }
+            segments_.push_back(found[i]);
+        }
+        if (!contiguous || torn[i]) {
+            for (size_t j = contiguous ? i + 1 : i; j < found.size(); ++j) {
+                std::cerr << "[MessageLog] Discarding " << found[j]->path << ", the history before it is incomplete\n";
+                found[j]->mapping.reset();  // Windows refuses to delete a mapped file
+                fs::remove(found[j]->path, error);
+                fs::remove(segment_path(found[j]->base_seq, ".idx"), error);
+            }
+            break;
+        }
+    }
+
+    if (segments_.empty()) {
+        write_seq_ = 1;
+        return start_segment(1) && load_tombstones();
+    }
+    active_ = segments_.back();
+    write_seq_ = active_->end_seq;
+    return active_file_.open(active_->path) && load_tombstones();
+}
+
+bool MessageLog::load_tombstones() {
+    const std::string path = (std::filesystem::path(directory_) / TOMBSTONE_FILE).string();
+    uint64_t valid = 0;
+    {
+        MappedFile file;
+        std::error_code error;
+        if (std::filesystem::exists(path, error) && file.open(path)) {
+            const uint64_t first = segments_.front()->base_seq;
+            for (; valid + TOMBSTONE_SIZE <= file.size(); valid += TOMBSTONE_SIZE) {
+                uint64_t seq;
+                uint32_t crc;
+                std::memcpy(&seq, file.data() + valid, sizeof(seq));
+                std::memcpy(&crc, file.data() + valid + 8, sizeof(crc));
+                if (crc32c(&seq, sizeof(seq)) != crc) break;
+                if (seq >= first && seq < write_seq_) tombstones_.insert(seq);
+            }
+        }
+    }
+
+    if (!tombstone_file_.open(path)) return false;
+    // A torn entry from a crash mid-erase
+    return tombstone_file_.size() == valid || tombstone_file_.truncate(valid);
+}
+
+bool MessageLog::erase(uint64_t seq) {
+    std::lock_guard<std::mutex> file_lock(tombstone_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(segments_mutex_);
+        if (segments_.empty() || seq < segments_.front()->base_seq || seq >= durable_seq()) return false;
+        if (tombstones_.count(seq)) return true;
+    }
+
+    // Synced before it takes effect, so an erased message never comes back after a crash
+    char entry[TOMBSTONE_SIZE];
+    const uint32_t crc = crc32c(&seq, sizeof(seq));
+    std::memcpy(entry, &seq, sizeof(seq));
+    std::memcpy(entry + 8, &crc, sizeof(crc));
+    const uint64_t size = tombstone_file_.size();
+    if (!tombstone_file_.is_open() || !tombstone_file_.append(entry, sizeof(entry)) || !tombstone_file_.sync()) {
+        std::cerr << "[MessageLog] Cannot record the erase of seq " << seq << " in " << directory_ << "\n";
+        if (tombstone_file_.is_open()) tombstone_file_.truncate(size);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(segments_mutex_);
+    tombstones_.insert(seq);
+    return true;
+}
+
+bool MessageLog::rewrite_tombstones() {
+    std::lock_guard<std::mutex> file_lock(tombstone_mutex_);
+    std::string data;
+    {
+        std::lock_guard<std::mutex> lock(segments_mutex_);
+        for (uint64_t seq : tombstones_) {
+            const uint32_t crc = crc32c(&seq, sizeof(seq));
+            data.append(reinterpret_cast<const char*>(&seq), sizeof(seq));
+            data.append(reinterpret_cast<const char*>(&crc), sizeof(crc));
+        }
+    }
+
+    // Replaced like a checkpoint; until then the old file still holds a superset
+    const std::string path = (std::filesystem::path(directory_) / TOMBSTONE_FILE).string();
+    tombstone_file_.close();
+    const bool written = write_file_atomically(path, data.data(), data.size());
+    const bool reopened = tombstone_file_.open(path);
+    if (!written || !reopened) {
+        std::cerr << "[MessageLog] Cannot rewrite " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+size_t MessageLog::enforce_retention(const RetentionPolicy& policy, int64_t now_ms) {
+    std::vector<std::shared_ptr<Segment>> expired;
+    bool dropped_tombstones = false;
+    {
+        std::lock_guard<std::mutex> lock(segments_mutex_);
+        if (segments_.empty()) return 0;
+        uint64_t total = 0;
+        for (size_t i = 0; i + 1 < segments_.size(); ++i) total += segments_[i]->size;
+
+        // The last segment is the one being written
+        const uint64_t durable = durable_seq();
+        while (segments_.size() > 1) {
+            const Segment& oldest = *segments_.front();
+            const bool too_old = policy.max_age_ms > 0 && oldest.max_time < now_ms - policy.max_age_ms;
+            const bool too_big = policy.max_bytes > 0 && total > policy.max_bytes;
+            const bool too_many = policy.max_count > 0 && durable - oldest.end_seq >= policy.max_count;
+            if (!too_old && !too_big && !too_many) break;
+            total -= oldest.size;
+            expired.push_back(segments_.front());
+            segments_.erase(segments_.begin());
+        }
+
+        auto kept = tombstones_.lower_bound(segments_.front()->base_seq);
+        dropped_tombstones = kept != tombstones_.begin();
+        tombstones_.erase(tombstones_.begin(), kept);
+    }
+
+    // The checkpoint goes first: a segment left without one is merely rescanned on restart
+    for (const auto& segment : expired) {
+        expired_files_.push_back(segment_path(segment->base_seq, ".idx"));
+        expired_files_.push_back(segment->path);
+    }
+    const size_t count = expired.size();
+    expired.clear();  // drops their mappings
+    remove_leftover_files();
+    if (dropped_tombstones) {
+        rewrite_tombstones();
+    }
+    return count;
+}
+
+uint64_t MessageLog::compact(uint64_t bytes_per_second) {
+    namespace fs = std::filesystem;
+    remove_leftover_files();
+
+    // The oldest sealed segment with tombstones whose records still have a body
+    std::shared_ptr<Segment> segment;
+    std::shared_ptr<MappedFile> source;
+    std::vector<uint64_t> erased;
+    bool dropped_tombstones = false;
+    for (;;) {
+        erased.clear();
+        {
+            std::lock_guard<std::mutex> lock(segments_mutex_);
+            if (tombstones_.empty() || segments_.size() < 2) break;
+            const uint64_t first = *tombstones_.begin();
+            auto it = std::upper_bound(segments_.begin(), segments_.end() - 1, first,
+                                       [](uint64_t seq, const std::shared_ptr<Segment>& candidate) {
+                                           return seq < candidate->base_seq;
+                                       });
+            if (it == segments_.begin() || first >= (*(it - 1))->end_seq) break;  // only the active one has any
+            segment = *(it - 1);
+            for (auto t = tombstones_.lower_bound(segment->base_seq); t != tombstones_.end() && *t < segment->end_seq; ++t) {
+                erased.push_back(*t);
+            }
+        }
+
+        source = std::make_shared<MappedFile>();
+        if (!source->open(segment->path) || source->size() < segment->size) {
+            std::cerr << "[MessageLog] Cannot map " << segment->path << " for compaction\n";
+            return 0;
+        }
+        uint64_t reclaimable = 0;
+        for (uint64_t seq : erased) {
+            uint64_t at = segment->base_seq + (seq - segment->base_seq) / SPARSE_EVERY * SPARSE_EVERY;
+            uint64_t offset = segment->sparse[(seq - segment->base_seq) / SPARSE_EVERY];
+            uint32_t body_size;
+            for (;; ++at) {
+                std::memcpy(&body_size, source->data() + offset + 4, sizeof(body_size));
+                if (at == seq) break;
+                offset += RECORD_HEADER_SIZE + body_size;
+            }
+            reclaimable += body_size;
+        }
+        if (reclaimable > 0) break;
+
+        // Already compacted (tombstones reloaded after a restart): nothing left to do for them
+        std::lock_guard<std::mutex> lock(segments_mutex_);
+        for (uint64_t seq : erased) tombstones_.erase(seq);
+        dropped_tombstones = true;
+        segment.reset();
+    }
+    if (!segment) {
+        if (dropped_tombstones) rewrite_tombstones();
+        return 0;
+    }
+
+    // The copy alternates between .log and .cmp; the previous one may still await removal
+    std::error_code error;
+    const bool original = segment->path.compare(segment->path.size() - 4, 4, ".log") == 0;
+    const std::string target = segment_path(segment->base_seq, original ? ".cmp" : ".log");
+    if (fs::exists(target, error)) return 0;
+    const std::string temp = segment_path(segment->base_seq, ".cmp.tmp");
+
+    auto compacted = std::make_shared<Segment>();
+    compacted->base_seq = segment->base_seq;
+    compacted->end_seq = segment->end_seq;
+    compacted->path = target;
+    compacted->sparse_time = segment->sparse_time;  // timestamps are kept, so the time index stands
+    compacted->max_time = segment->max_time;
+
+    AppendFile out;
+    bool ok = out.open(temp) && out.truncate(0) && out.append(MAGIC, sizeof(MAGIC));
+    const char* data = source->data();
+    const auto started = std::chrono::steady_clock::now();
+    std::string chunk;
+    uint64_t offset = sizeof(MAGIC);
+    uint64_t written = sizeof(MAGIC);
+    size_t next_erased = 0;
+    for (uint64_t seq = segment->base_seq; ok && seq < segment->end_seq; ++seq) {
+        uint32_t body_size;
+        std::memcpy(&body_size, data + offset + 4, sizeof(body_size));
+        const uint64_t record_size = RECORD_HEADER_SIZE + (uint64_t)body_size;
+        if ((seq - segment->base_seq) % SPARSE_EVERY == 0) {
+            compacted->sparse.push_back(written + chunk.size());
+        }
+
+        while (next_erased < erased.size() && erased[next_erased] < seq) ++next_erased;
+        if (next_erased < erased.size() && erased[next_erased] == seq && body_size > 0) {
+            // Same seq and timestamp, no body
+            char header[RECORD_HEADER_SIZE];
+            std::memcpy(header, data + offset, sizeof(header));
+            const uint32_t empty_body = 0;
+            const uint16_t empty_sender = 0;
+            uint16_t flags;
+            std::memcpy(&flags, header + 26, sizeof(flags));
+            flags |= FLAG_DELETED;
+            std::memcpy(header + 4, &empty_body, sizeof(empty_body));
+            std::memcpy(header + 24, &empty_sender, sizeof(empty_sender));
+            std::memcpy(header + 26, &flags, sizeof(flags));
+            const uint32_t crc = crc32c(header + 4, RECORD_HEADER_SIZE - 4);
+            std::memcpy(header, &crc, sizeof(crc));
+            chunk.append(header, sizeof(header));
+        } else {
+            chunk.append(data + offset, record_size);
+        }
+        offset += record_size;
+
+        if (chunk.size() >= COMPACT_CHUNK || seq + 1 == segment->end_seq) {
+            ok = out.append(chunk.data(), chunk.size());
+            written += chunk.size();
+            chunk.clear();
+            // Paced by bytes read, so a large rewrite never saturates the disk the writer syncs to
+            if (bytes_per_second > 0) {
+                std::this_thread::sleep_until(started + std::chrono::microseconds(offset * 1000000 / bytes_per_second));
+            }
+        }
+    }
+    ok = ok && out.sync();
+    compacted->size = written;
+    out.close();
+    source.reset();
+    if (ok) {
+        fs::rename(temp, target, error);
+    }
+    if (!ok || error) {
+        std::cerr << "[MessageLog] Cannot compact " << segment->path << "\n";
+        fs::remove(temp, error);
+        return 0;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(segments_mutex_);
+        auto it = std::find(segments_.begin(), segments_.end(), segment);
+        if (it != segments_.end()) *it = compacted;
+        for (uint64_t seq : erased) tombstones_.erase(seq);
+    }
+    write_checkpoint(*compacted);
+
+    const uint64_t reclaimed = segment->size - compacted->size;
+    const std::string replaced = segment->path;
+    segment.reset();  // drops its mapping
+    fs::remove(replaced, error);
+    if (error) {
+        replaced_files_.push_back(replaced);
+    }
+    rewrite_tombstones();
+    return reclaimed;
+}
+
+void MessageLog::remove_leftover_files() {
+    std::error_code error;
+    size_t removed = 0;
+    while (removed < expired_files_.size()) {
+        std::filesystem::remove(expired_files_[removed], error);
+        if (error) break;
+        ++removed;
+    }
+    expired_files_.erase(expired_files_.begin(), expired_files_.begin() + removed);
+
+    replaced_files_.erase(std::remove_if(replaced_files_.begin(), replaced_files_.end(), [&error](const std::string& path) {
+        std::filesystem::remove(path, error);
+        return !error;
+    }), replaced_files_.end());
+}
+
+bool MessageLog::scan(const std::string& directory, const std::function<bool(const Entry&)>& visit) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+
+    // The same file per segment that recover() would keep: a compacted copy wins while smaller
+    std::map<uint64_t, fs::path> files;
+    for (const auto& item : fs::directory_iterator(directory, error)) {
+        const std::string name = item.path().filename().string();
+        const bool numbered = name.size() == 24 &&
+            std::all_of(name.begin(), name.begin() + 20, [](char c) { return c >= '0' && c <= '9'; });
+        if (!numbered || (name.compare(20, 4, ".log") != 0 && name.compare(20, 4, ".cmp") != 0)) continue;
+        const uint64_t base = std::stoull(name.substr(0, 20));
+        auto it = files.find(base);
+        std::error_code size_error;
+        if (it == files.end() || fs::file_size(item.path(), size_error) < fs::file_size(it->second, size_error)) {
+            files[base] = item.path();
+        }
+    }
+    if (error) {
+        std::cerr << "[MessageLog] Cannot list " << directory << ": " << error.message() << "\n";
+        return false;
+    }
+
+    std::vector<uint64_t> erased;
+    {
+        const std::string path = (fs::path(directory) / TOMBSTONE_FILE).string();
+        MappedFile file;
+        if (fs::exists(path, error) && file.open(path)) {
+            for (uint64_t offset = 0; offset + TOMBSTONE_SIZE <= file.size(); offset += TOMBSTONE_SIZE) {
+                uint64_t seq;
+                uint32_t crc;
+                std::memcpy(&seq, file.data() + offset, sizeof(seq));
+                std::memcpy(&crc, file.data() + offset + 8, sizeof(crc));
+                if (crc32c(&seq, sizeof(seq)) != crc) break;
+                erased.push_back(seq);
+            }
+        }
+        std::sort(erased.begin(), erased.end());
+    }
+
+    uint64_t expected_seq = files.empty() ? 0 : files.begin()->first;
+    for (const auto& file : files) {
+        if (file.first != expected_seq) break;
+        auto mapping = std::make_shared<MappedFile>();
+        if (!mapping->open(file.second.string())) return false;
+        const uint64_t file_size = mapping->size();
+        const char* data = mapping->data();
+        if (file_size < sizeof(MAGIC) || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) break;
+
+        uint64_t offset = sizeof(MAGIC);
+        while (offset + RECORD_HEADER_SIZE <= file_size) {
+            uint32_t crc;
+            uint32_t body_size;
+            uint64_t seq;
+            uint16_t sender_size;
+            uint16_t flags;
+            Entry entry;
+            std::memcpy(&crc, data + offset, sizeof(crc));
+            std::memcpy(&body_size, data + offset + 4, sizeof(body_size));
+            std::memcpy(&seq, data + offset + 8, sizeof(seq));
+            std::memcpy(&entry.timestamp_ms, data + offset + 16, sizeof(entry.timestamp_ms));
+            std::memcpy(&sender_size, data + offset + 24, sizeof(sender_size));
+            std::memcpy(&flags, data + offset + 26, sizeof(flags));
+            const uint64_t record_size = RECORD_HEADER_SIZE + (uint64_t)body_size;
+            if (offset + record_size > file_size || seq != expected_seq || sender_size > body_size ||
+                crc32c(data + offset + 4, record_size - 4) != crc) {
+                return true;  // damaged, or a record the writer is still appending
+            }
+
+            entry.seq = seq;
+            entry.deleted = (flags & FLAG_DELETED) != 0 || std::binary_search(erased.begin(), erased.end(), seq);
+            if (!entry.deleted) {
+                const char* body = data + offset + RECORD_HEADER_SIZE;
+                entry.sender = std::string_view(body, sender_size);
+                entry.text = std::string_view(body + sender_size, body_size - sender_size);
+            }
+            entry.mapping = mapping;
+            if (!visit(entry)) return false;
+            offset += record_size;
+            ++expected_seq;
+        }
+    }
+    return true;
+}
+
+bool MessageLog::scan_segment(Segment& segment, bool& torn) {
+    auto mapping = std::make_shared<MappedFile>();
+    if (!mapping->open(segment.path)) return false;
+
+    const uint64_t file_size = mapping->size();
+    const char* data = mapping->data();
+    if (file_size >= sizeof(MAGIC) && std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        std::cerr << "[MessageLog] " << segment.path << " is not a log segment\n";
+        return false;
+    }
+
+    uint64_t expected_seq = segment.base_seq;
+    int64_t max_time = INT64_MIN;
+    uint64_t offset = sizeof(MAGIC);
+    while (file_size >= sizeof(MAGIC) && offset + RECORD_HEADER_SIZE <= file_size) {
+        uint32_t crc;
+        uint32_t body_size;
+        uint64_t seq;
+        int64_t timestamp_ms;
+        std::memcpy(&crc, data + offset, sizeof(crc));
+        std::memcpy(&body_size, data + offset + 4, sizeof(body_size));
+        std::memcpy(&seq, data + offset + 8, sizeof(seq));
+        std::memcpy(&timestamp_ms, data + offset + 16, sizeof(timestamp_ms));
+        const uint64_t record_size = RECORD_HEADER_SIZE + (uint64_t)body_size;
+        if (offset + record_size > file_size || seq != expected_seq ||
+            crc32c(data + offset + 4, record_size - 4) != crc) {
+            break;
+        }
+
+        max_time = std::max(max_time, timestamp_ms);
+        if ((seq - segment.base_seq) % SPARSE_EVERY == 0) {
+            segment.sparse.push_back(offset);
+            segment.sparse_time.push_back(max_time);
+        }
+        offset += record_size;
+        ++expected_seq;
+    }
+    segment.end_seq = expected_seq;
+    segment.size = offset;
+    segment.max_time = max_time;
+
+    if (file_size == offset) {
+        segment.mapping = std::move(mapping);
+        return true;
+    }
+
+    // A crash mid-write (or before the magic made it out): cut back to the last good record
+    torn = true;
+    std::cerr << "[MessageLog] Dropping torn tail of " << segment.path << " at seq " << expected_seq << "\n";
+    mapping.reset();  // Windows refuses to truncate a mapped region
+    AppendFile file;
+    if (!file.open(segment.path)) return false;
+    if (file_size < sizeof(MAGIC)) {
+        return file.truncate(0) && file.append(MAGIC, sizeof(MAGIC));
+    }
+    return file.truncate(offset);
+}
+
+bool MessageLog::load_checkpoint(Segment& segment) const {
+    const std::string path = segment_path(segment.base_seq, ".idx");
+    MappedFile file;
+    std::error_code error;
+    if (!std::filesystem::exists(path, error) || !file.open(path)) return false;
+
+    // Fixed part, then the sparse entries, then the CRC
+    const size_t fixed = sizeof(CHECKPOINT_MAGIC) + 5 * 8;
+    const char* data = file.data();
+    uint64_t header[5];
+    if (file.size() < fixed + 4 || std::memcmp(data, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) return false;
+    std::memcpy(header, data + sizeof(CHECKPOINT_MAGIC), sizeof(header));
+    const uint64_t count = header[4];
+    if (count > (file.size() - fixed - 4) / 16 || file.size() != fixed + count * 16 + 4) return false;
+    uint32_t crc;
+    std::memcpy(&crc, data + file.size() - 4, sizeof(crc));
+    if (crc32c(data, file.size() - 4) != crc) return false;
+
+    // Only valid for the exact file it was taken of
+    if (header[0] != segment.base_seq || header[2] != std::filesystem::file_size(segment.path, error) || error) {
+        return false;
+    }
+
+    segment.end_seq = header[1];
+    segment.size = header[2];
+    std::memcpy(&segment.max_time, &header[3], sizeof(segment.max_time));
+    segment.sparse.resize(count);
+    segment.sparse_time.resize(count);
+    for (uint64_t k = 0; k < count; ++k) {
+        std::memcpy(&segment.sparse[k], data + fixed + k * 16, 8);
+        std::memcpy(&segment.sparse_time[k], data + fixed + k * 16 + 8, 8);
+    }
+    return true;
+}
+
+bool MessageLog::write_checkpoint(const Segment& segment) const {
+    std::string data(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    auto put = [&data](const auto& value) { data.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    put(segment.base_seq);
+    put(segment.end_seq);
+    put(segment.size);
+    put(segment.max_time);
+    put((uint64_t)segment.sparse.size());
+    for (size_t k = 0; k < segment.sparse.size(); ++k) {
+        put(segment.sparse[k]);
+        put(segment.sparse_time[k]);
+    }
+    put(crc32c(data.data(), data.size()));
+
+    // A checkpoint is either complete or absent
+    const std::string path = segment_path(segment.base_seq, ".idx");
+    if (!write_file_atomically(path, data.data(), data.size())) {
+        std::cerr << "[MessageLog] Cannot checkpoint " << segment.path << ", it will be rescanned on restart\n";
+        return false;
+    }
+    return true;
+}
+
+bool MessageLog::start_segment(uint64_t base_seq) {
+    auto segment = std::make_shared<Segment>();
+    segment->base_seq = base_seq;
+    segment->end_seq = base_seq;
+    segment->size = sizeof(MAGIC);
+    segment->max_time = max_time_;
+    segment->path = segment_path(base_seq);
+
+    active_file_.close();
+    if (!active_file_.open(segment->path)) return false;
+    // Left over from a discarded range, if anything
+    if (active_file_.size() != 0 && !active_file_.truncate(0)) return false;
+    std::error_code error;
+    std::filesystem::remove(segment_path(base_seq, ".idx"), error);
+    if (!active_file_.append(MAGIC, sizeof(MAGIC))) return false;
+
+    active_ = segment;
+    new_sparse_.clear();
+    new_sparse_time_.clear();
+    std::lock_guard<std::mutex> lock(segments_mutex_);
+    segments_.push_back(std::move(segment));
+    return true;
+}
+
+void MessageLog::writer_loop() {
+    std::string batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(pending_mutex_);
+            pending_cv_.wait(lock, [this] { return !pending_.empty() || stopping_; });
+            if (pending_.empty()) break;
+            // Everything queued while the previous batch was being synced goes out together
+            batch.swap(pending_);
+        }
+        space_cv_.notify_all();
+
+        bool failed;
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            failed = write_failed_;
+        }
+        if (!failed && !write_batch(batch)) {
+            // Unsynced bytes may hold a partial record; cut back to what readers already trust.
+            // append() hands out no more seqs, so none are promised that can never be read back.
+            std::cerr << "[MessageLog] Write failed, history is no longer persisted in " << directory_ << "\n";
+            {
+                std::lock_guard<std::mutex> lock(pending_mutex_);
+                write_failed_ = true;
+            }
+            active_file_.truncate(active_->size);
+        }
+        batch.clear();
+    }
+}
+
+bool MessageLog::write_batch(const std::string& batch) {
+    size_t pos = 0;
+    while (pos < batch.size()) {
+        // As many whole records as still fit in the active segment
+        const uint64_t file_size = active_file_.size();
+        size_t end = pos;
+        while (end < batch.size()) {
+            uint32_t body_size;
+            int64_t timestamp_ms;
+            std::memcpy(&body_size, batch.data() + end + 4, sizeof(body_size));
+            std::memcpy(&timestamp_ms, batch.data() + end + 16, sizeof(timestamp_ms));
+            const size_t record_size = RECORD_HEADER_SIZE + body_size;
+            // An oversized record still gets an otherwise empty segment of its own
+            const bool segment_empty = end == pos && write_seq_ == active_->base_seq;
+            if (file_size + (end - pos) + record_size > SEGMENT_BYTES && !segment_empty) break;
+
+            max_time_ = std::max(max_time_, timestamp_ms);
+            if ((write_seq_ - active_->base_seq) % SPARSE_EVERY == 0) {
+                new_sparse_.push_back(file_size + (end - pos));
+                new_sparse_time_.push_back(max_time_);
+            }
+            end += record_size;
+            ++write_seq_;
+        }
+
+        if (end > pos && !active_file_.append(batch.data() + pos, end - pos)) return false;
+        pos = end;
+
+        if (pos < batch.size()) {
+            // Seal the full segment and carry on in a new one
+            if (!active_file_.sync()) return false;
+            publish();
+            write_checkpoint(*active_);  // sealed for good; a failure only costs a rescan
+            if (!start_segment(write_seq_)) return false;
+        }
+    }
+    if (!active_file_.sync()) return false;
+    publish();
+    return true;
+}
+
+void MessageLog::publish() {
+    std::lock_guard<std::mutex> lock(segments_mutex_);
+    active_->end_seq = write_seq_;
+    active_->size = active_file_.size();
+    active_->max_time = max_time_;
+    active_->sparse.insert(active_->sparse.end(), new_sparse_.begin(), new_sparse_.end());
+    active_->sparse_time.insert(active_->sparse_time.end(), new_sparse_time_.begin(), new_sparse_time_.end());
+    new_sparse_.clear();
+    new_sparse_time_.clear();
+    durable_seq_.store(write_seq_, std::memory_order_release);
+    durable_cv_.notify_all();
+}
+
+std::string MessageLog::segment_path(uint64_t base_seq, const char* extension) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%020llu%s", (unsigned long long)base_seq, extension);
+    return (std::filesystem::path(directory_) / name).string();
+}
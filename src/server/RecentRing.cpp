@@ -0,0 +1,79 @@
+#include "server/RecentRing.hpp"
+#include <algorithm>
+
+RecentRing::RecentRing(size_t capacity, size_t max_bytes)
+    : slots_(capacity > 0 ? capacity : 1), head_(0), count_(0), bytes_(0), max_bytes_(max_bytes) {
+}
+
+void RecentRing::push(const MessageView& frame) {
+    if (frame.text.size() > max_bytes_) return;  // would evict everything and still not fit
+
+    while (count_ > 0 && (count_ == slots_.size() || bytes_ + frame.text.size() > max_bytes_)) {
+        pop_oldest();
+    }
+    slots_[(head_ + count_) % slots_.size()] = frame;
+    ++count_;
+    bytes_ += frame.text.size();
+}
+
+void RecentRing::clear() {
+    while (count_ > 0) {
+        pop_oldest();
+    }
+    head_ = 0;
+}
+
+void RecentRing::replace(const MessageView& frame) {
+    const uint64_t oldest = first_seq();
+    if (oldest == 0 || frame.seq < oldest || frame.seq - oldest >= count_) return;
+
+    MessageView& slot = slots_[(head_ + (frame.seq - oldest)) % slots_.size()];
+    bytes_ = bytes_ - slot.text.size() + frame.text.size();
+    slot = frame;
+}
+
+size_t RecentRing::size() const {
+    return count_;
+}
+
+size_t RecentRing::bytes() const {
+    return bytes_;
+}
+
+uint64_t RecentRing::first_seq() const {
+    return count_ > 0 ? slots_[head_].seq : 0;
+}
+
+void RecentRing::spans(std::vector<std::string_view>& out) const {
+    for (size_t i = 0; i < count_; ++i) {
+        const std::string_view text = slots_[(head_ + i) % slots_.size()].text;
+        if (text.empty()) continue;
+        if (!out.empty() && out.back().data() + out.back().size() == text.data()) {
+            out.back() = std::string_view(out.back().data(), out.back().size() + text.size());
+        } else {
+            out.push_back(text);
+        }
+    }
+}
+
+void RecentRing::frames(uint64_t first_seq, uint64_t last_seq, std::vector<MessageView>& out) const {
+    const uint64_t oldest = this->first_seq();
+    if (oldest == 0 || first_seq > last_seq) return;  // empty, or a room without history
+
+    // Consecutive seqs, so the range maps straight onto slots
+    const uint64_t newest = oldest + count_ - 1;
+    first_seq = std::max(first_seq, oldest);
+    last_seq = std::min(last_seq, newest);
+    for (uint64_t seq = first_seq; seq <= last_seq; ++seq) {
+        const MessageView& slot = slots_[(head_ + (seq - oldest)) % slots_.size()];
+        if (!slot.text.empty()) out.push_back(slot);
+    }
+}
+
+void RecentRing::pop_oldest() {
+    MessageView& slot = slots_[head_];
+    bytes_ -= slot.text.size();
+    slot = MessageView{};  // hands the buffer back to the pool once nothing else shares it
+    head_ = (head_ + 1) % slots_.size();
+    --count_;
+}
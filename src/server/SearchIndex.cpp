@@ -0,0 +1,509 @@
+#include "server/SearchIndex.hpp"
+#include "server/MessageLog.hpp"
+#include "storage/AppendFile.hpp"
+#include "storage/MappedFile.hpp"
+#include "storage/Crc32c.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+bool is_term_char(char c) {
+    unsigned char u = (unsigned char)c;
+    return u >= 0x80 || (u >= '0' && u <= '9') || (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z');
+}
+
+char fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : (is_term_char(c) ? c : ' ');
+}
+
+// Splits sender and text into terms; `tokens` points into `folded`
+void tokenize(std::string_view sender, std::string_view text, std::string& folded,
+              std::vector<std::string_view>& tokens) {
+    folded.clear();
+    folded.reserve(sender.size() + text.size() + 1);
+    for (char c : sender) folded.push_back(fold(c));
+    folded.push_back(' ');
+    for (char c : text) folded.push_back(fold(c));
+
+    tokens.clear();
+    size_t pos = 0;
+    while (pos < folded.size()) {
+        while (pos < folded.size() && folded[pos] == ' ') ++pos;
+        size_t start = pos;
+        while (pos < folded.size() && folded[pos] != ' ') ++pos;
+        if (pos > start) {
+            tokens.emplace_back(folded.data() + start, std::min(pos - start, SearchIndex::MAX_TERM_LENGTH));
+        }
+    }
+}
+
+void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+uint64_t get_varint(const char*& pos) {
+    uint64_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        const uint8_t byte = (uint8_t)*pos++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (byte < 0x80) return value;
+    }
+}
+
+bool term_matches(std::string_view term, std::string_view query_term, bool prefix) {
+    return prefix ? term.substr(0, query_term.size()) == query_term : term == query_term;
+}
+
+// Intersects the postings of every query term into `out`, ascending. lookup(term, prefix, list)
+// appends the postings of `term`, or of up to MAX_PREFIX_TERMS terms starting with it, and
+// returns how many terms matched; the sealed segments and the recent table each provide one.
+template <typename Lookup>
+void match_terms(const std::vector<std::string_view>& terms, bool prefix_last, Lookup lookup,
+                 std::vector<uint64_t>& out) {
+    std::vector<std::vector<uint64_t>> lists(terms.size());
+    for (size_t t = 0; t < terms.size(); ++t) {
+        const size_t matched = lookup(terms[t], prefix_last && t + 1 == terms.size(), lists[t]);
+        if (lists[t].empty()) return;
+        if (matched > 1) {
+            std::sort(lists[t].begin(), lists[t].end());
+            lists[t].erase(std::unique(lists[t].begin(), lists[t].end()), lists[t].end());
+        }
+    }
+
+    // Rarest term first keeps every intermediate result small
+    std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) { return a.size() < b.size(); });
+    std::vector<uint64_t> result = std::move(lists[0]);
+    std::vector<uint64_t> scratch;
+    for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+        scratch.clear();
+        std::set_intersection(result.begin(), result.end(), lists[i].begin(), lists[i].end(),
+                              std::back_inserter(scratch));
+        result.swap(scratch);
+    }
+    out.insert(out.end(), result.begin(), result.end());
+}
+
+}  // namespace
+
+SearchIndex::SearchIndex() : log_(nullptr), stopping_(false), recent_base_(0), indexed_seq_(0) {
+}
+
+SearchIndex::~SearchIndex() {
+    close();
+}
+
+bool SearchIndex::open(MessageLog& log, const std::string& directory) {
+    close();
+    if (!log.is_open()) return false;
+
+    if (!directory.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (error) {
+            std::cerr << "[SearchIndex] Cannot create " << directory << ", the index will not be checkpointed\n";
+        } else {
+            directory_ = directory;
+        }
+    }
+    log_ = &log;
+    stopping_ = false;
+    const uint64_t first = log.first_seq();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        recent_base_ = first;
+    }
+    indexed_seq_.store(first);
+    indexer_ = std::thread(&SearchIndex::indexer_loop, this);
+    return true;
+}
+
+void SearchIndex::close() {
+    stopping_ = true;
+    if (indexer_.joinable()) {
+        indexer_.join();
+    }
+    log_ = nullptr;
+    directory_.clear();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    segments_.clear();
+    recent_.clear();
+    recent_base_ = 0;
+    indexed_seq_.store(0);
+}
+
+uint64_t SearchIndex::indexed_seq() const {
+    return indexed_seq_.load();
+}
+
+size_t SearchIndex::segment_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return segments_.size();
+}
+
+bool SearchIndex::search(std::string_view query, uint64_t before_seq, size_t max_count, std::vector<uint64_t>& out) {
+    std::string folded;
+    std::vector<std::string_view> terms;
+    tokenize({}, query, folded, terms);
+    if (terms.empty()) return false;
+    const bool prefix_last = is_term_char(query.back());
+    if (before_seq == 0) before_seq = UINT64_MAX;
+    // The oldest segment may still hold postings of messages retention has deleted
+    const uint64_t first = log_ ? log_->first_seq() : 0;
+
+    const size_t start = out.size();
+    auto take_newest = [&](const std::vector<uint64_t>& hits) {
+        for (auto it = hits.rbegin(); it != hits.rend() && out.size() - start < max_count && *it >= first; ++it) {
+            if (*it < before_seq) out.push_back(*it);
+        }
+    };
+
+    // The unsealed tail is the newest part and small; it is matched under the lock
+    std::vector<uint64_t> hits;
+    std::vector<std::shared_ptr<const Segment>> segments;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        match_recent(terms, prefix_last, hits);
+        segments = segments_;
+    }
+    take_newest(hits);
+
+    for (auto it = segments.rbegin(); it != segments.rend() && out.size() - start < max_count; ++it) {
+        if ((*it)->base_seq >= before_seq) continue;
+        hits.clear();
+        match_segment(**it, terms, prefix_last, hits);
+        take_newest(hits);
+    }
+    return true;
+}
+
+void SearchIndex::match_recent(const std::vector<std::string_view>& terms, bool prefix_last,
+                               std::vector<uint64_t>& out) const {
+    auto lookup = [this](std::string_view term, bool prefix, std::vector<uint64_t>& list) {
+        size_t matched = 0;
+        for (auto it = recent_.lower_bound(term);
+             it != recent_.end() && matched < MAX_PREFIX_TERMS && term_matches(it->first, term, prefix); ++it) {
+            list.insert(list.end(), it->second.begin(), it->second.end());
+            ++matched;
+        }
+        return matched;
+    };
+    match_terms(terms, prefix_last, lookup, out);
+}
+
+void SearchIndex::match_segment(const Segment& segment, const std::vector<std::string_view>& terms, bool prefix_last,
+                                std::vector<uint64_t>& out) {
+    auto lookup = [&segment](std::string_view term, bool prefix, std::vector<uint64_t>& list) {
+        const std::vector<std::string>& dictionary = segment.terms;
+        size_t matched = 0;
+        for (auto it = std::lower_bound(dictionary.begin(), dictionary.end(), term);
+             it != dictionary.end() && matched < MAX_PREFIX_TERMS && term_matches(*it, term, prefix); ++it) {
+            decode(segment, (size_t)(it - dictionary.begin()), list);
+            ++matched;
+        }
+        return matched;
+    };
+    match_terms(terms, prefix_last, lookup, out);
+}
+
+void SearchIndex::decode(const Segment& segment, size_t term, std::vector<uint64_t>& out) {
+    const char* pos = segment.postings.data() + segment.offsets[term];
+    const char* end = segment.postings.data() + segment.offsets[term + 1];
+    uint64_t seq = segment.base_seq;
+    while (pos < end) {
+        seq += get_varint(pos);
+        out.push_back(seq);
+    }
+}
+
+void SearchIndex::indexer_loop() {
+    std::vector<MessageLog::Entry> entries;
+    std::string folded;
+    std::vector<std::string_view> tokens;
+
+    if (!directory_.empty()) {
+        load_checkpoints();
+    }
+    while (!stopping_) {
+        drop_expired();
+        const uint64_t next = indexed_seq_.load();
+        if (!log_->wait_durable(next, WAIT_INTERVAL)) continue;
+
+        // Segments end on multiples of SEAL_EVERY, so a batch never crosses that boundary
+        const uint64_t seal_at = (recent_base_ / SEAL_EVERY + 1) * SEAL_EVERY;
+        entries.clear();
+        log_->read(next, (size_t)std::min<uint64_t>(READ_BATCH, seal_at - next), entries);
+        while (!entries.empty() && entries.back().seq >= seal_at) entries.pop_back();  // retention skipped ahead
+        if (entries.empty()) continue;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const MessageLog::Entry& entry : entries) {
+                tokenize(entry.sender, entry.text, folded, tokens);
+                std::sort(tokens.begin(), tokens.end());
+                tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+                for (std::string_view token : tokens) {
+                    auto it = recent_.find(token);
+                    if (it == recent_.end()) {
+                        it = recent_.emplace(std::string(token), std::vector<uint64_t>{}).first;
+                    }
+                    it->second.push_back(entry.seq);
+                }
+            }
+        }
+        indexed_seq_.store(entries.back().seq + 1);
+
+        if (entries.back().seq + 1 >= seal_at) {
+            seal();
+            merge_tail();
+        }
+    }
+}
+
+void SearchIndex::drop_expired() {
+    const uint64_t first = log_->first_seq();
+    std::vector<std::shared_ptr<const Segment>> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (!segments_.empty() && segments_.front()->end_seq <= first) {
+            expired.push_back(segments_.front());
+            segments_.erase(segments_.begin());
+        }
+        // Retention deleted messages not indexed yet: start over at the log's first message
+        if (indexed_seq_.load() < first) {
+            recent_.clear();
+            recent_base_ = first / SEAL_EVERY * SEAL_EVERY;
+            indexed_seq_.store(recent_base_);
+        }
+    }
+
+    if (!directory_.empty()) {
+        std::error_code error;
+        for (const auto& segment : expired) {
+            std::filesystem::remove(checkpoint_path(segment->base_seq, segment->end_seq), error);
+        }
+    }
+}
+
+void SearchIndex::seal() {
+    auto segment = std::make_shared<Segment>();
+    segment->base_seq = recent_base_;
+    segment->end_seq = indexed_seq_.load();
+    segment->level = 0;
+
+    // Only this thread changes recent_, so reading it needs no lock
+    segment->terms.reserve(recent_.size());
+    segment->offsets.reserve(recent_.size() + 1);
+    for (const auto& [term, seqs] : recent_) {
+        segment->terms.push_back(term);
+        segment->offsets.push_back(segment->postings.size());
+        uint64_t previous = segment->base_seq;
+        for (uint64_t seq : seqs) {
+            put_varint(segment->postings, seq - previous);
+            previous = seq;
+        }
+    }
+    segment->offsets.push_back(segment->postings.size());
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        segments_.push_back(segment);
+        recent_.clear();
+        recent_base_ = segment->end_seq;
+    }
+    write_checkpoint(*segment);
+}
+
+void SearchIndex::merge_tail() {
+    for (;;) {
+        std::vector<std::shared_ptr<const Segment>> inputs;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (segments_.size() < MERGE_FANIN) return;
+            inputs.assign(segments_.end() - MERGE_FANIN, segments_.end());
+        }
+        const uint32_t level = inputs.back()->level;
+        if (level >= MAX_LEVEL) return;
+        for (const auto& input : inputs) {
+            if (input->level != level) return;
+        }
+
+        // Searches keep using the inputs until the merged segment replaces them
+        std::shared_ptr<const Segment> merged = merge(inputs);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            segments_.erase(segments_.end() - MERGE_FANIN, segments_.end());
+            segments_.push_back(merged);
+        }
+
+        // The merged checkpoint supersedes the inputs'; if it is lost, theirs still load
+        write_checkpoint(*merged);
+        if (!directory_.empty()) {
+            std::error_code error;
+            for (const auto& input : inputs) {
+                std::filesystem::remove(checkpoint_path(input->base_seq, input->end_seq), error);
+            }
+        }
+    }
+}
+
+std::shared_ptr<const SearchIndex::Segment> SearchIndex::merge(const std::vector<std::shared_ptr<const Segment>>& inputs) {
+    auto merged = std::make_shared<Segment>();
+    merged->base_seq = inputs.front()->base_seq;
+    merged->end_seq = inputs.back()->end_seq;
+    merged->level = inputs.front()->level + 1;
+
+    // k-way merge of the sorted dictionaries; postings are appended in seq order
+    std::vector<size_t> cursors(inputs.size(), 0);
+    std::vector<uint64_t> seqs;
+    for (;;) {
+        const std::string* term = nullptr;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (cursors[i] < inputs[i]->terms.size() && (!term || inputs[i]->terms[cursors[i]] < *term)) {
+                term = &inputs[i]->terms[cursors[i]];
+            }
+        }
+        if (!term) break;
+
+        merged->terms.push_back(*term);
+        merged->offsets.push_back(merged->postings.size());
+        uint64_t previous = merged->base_seq;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (cursors[i] >= inputs[i]->terms.size() || inputs[i]->terms[cursors[i]] != merged->terms.back()) continue;
+            seqs.clear();
+            decode(*inputs[i], cursors[i]++, seqs);
+            for (uint64_t seq : seqs) {
+                put_varint(merged->postings, seq - previous);
+                previous = seq;
+            }
+        }
+    }
+    merged->offsets.push_back(merged->postings.size());
+    return merged;
+}
+
+void SearchIndex::load_checkpoints() {
+    namespace fs = std::filesystem;
+    struct Found {
+        uint64_t base_seq;
+        uint64_t end_seq;
+        std::string path;
+    };
+    std::vector<Found> found;
+    std::error_code error;
+    for (const auto& item : fs::directory_iterator(directory_, error)) {
+        const std::string name = item.path().filename().string();
+        unsigned long long base;
+        unsigned long long end;
+        char tail;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+            fs::remove(item.path(), error);  // a write cut short
+        } else if (name.size() == 45 && std::sscanf(name.c_str(), "%20llu-%20llu.id%c", &base, &end, &tail) == 3 &&
+            tail == 'x' && base < end) {
+            found.push_back({base, end, item.path().string()});
+        }
+    }
+
+    // Chain the widest checkpoint at each point from the log's first message on. Anything left
+    // over was superseded by a merge or covers messages the log no longer has.
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) {
+        return a.base_seq != b.base_seq ? a.base_seq < b.base_seq : a.end_seq > b.end_seq;
+    });
+    uint64_t next = indexed_seq_.load();
+    const uint64_t durable = log_->durable_seq();
+    for (const Found& checkpoint : found) {
+        if (stopping_) break;
+        const bool links = checkpoint.base_seq <= next && next < checkpoint.end_seq && checkpoint.end_seq <= durable;
+        if (links) {
+            if (std::shared_ptr<const Segment> segment = read_checkpoint(checkpoint.path)) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                segments_.push_back(std::move(segment));
+                next = checkpoint.end_seq;
+                recent_base_ = next;
+                indexed_seq_.store(next);
+                continue;
+            }
+            std::cerr << "[SearchIndex] " << checkpoint.path << " is damaged, re-indexing from seq " << next << "\n";
+        }
+        if (links || checkpoint.end_seq <= next || checkpoint.end_seq > durable) {
+            fs::remove(checkpoint.path, error);
+        }
+    }
+}
+
+void SearchIndex::write_checkpoint(const Segment& segment) const {
+    if (directory_.empty()) return;
+
+    std::string data(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    auto put = [&data](const auto& value) { data.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    put(segment.base_seq);
+    put(segment.end_seq);
+    put(segment.level);
+    put((uint32_t)segment.terms.size());
+    for (const std::string& term : segment.terms) {
+        put((uint8_t)term.size());
+        data += term;
+    }
+    for (uint64_t offset : segment.offsets) put(offset);
+    data += segment.postings;
+    put(crc32c(data.data(), data.size()));
+
+    // A checkpoint is either complete or absent
+    const std::string path = checkpoint_path(segment.base_seq, segment.end_seq);
+    if (!write_file_atomically(path, data.data(), data.size())) {
+        std::cerr << "[SearchIndex] Cannot write " << path << "\n";
+    }
+}
+
+std::shared_ptr<const SearchIndex::Segment> SearchIndex::read_checkpoint(const std::string& path) {
+    MappedFile file;
+    if (!file.open(path) || file.size() < sizeof(CHECKPOINT_MAGIC) + 28) return nullptr;
+    const char* data = file.data();
+    const size_t body = file.size() - 4;
+    uint32_t crc;
+    std::memcpy(&crc, data + body, sizeof(crc));
+    if (std::memcmp(data, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 || crc32c(data, body) != crc) {
+        return nullptr;
+    }
+
+    // The CRC matched, so only a file written by a different build could still be malformed
+    size_t pos = sizeof(CHECKPOINT_MAGIC);
+    auto get = [&](auto& value) {
+        if (pos + sizeof(value) > body) return false;
+        std::memcpy(&value, data + pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    };
+    auto segment = std::make_shared<Segment>();
+    uint32_t count;
+    if (!get(segment->base_seq) || !get(segment->end_seq) || !get(segment->level) || !get(count)) return nullptr;
+    segment->terms.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint8_t length;
+        if (!get(length) || pos + length > body) return nullptr;
+        segment->terms.emplace_back(data + pos, length);
+        pos += length;
+    }
+    segment->offsets.resize((size_t)count + 1);
+    for (uint64_t& offset : segment->offsets) {
+        if (!get(offset)) return nullptr;
+    }
+    if (segment->offsets.back() != body - pos) return nullptr;
+    segment->postings.assign(data + pos, body - pos);
+    return segment;
+}
+
+std::string SearchIndex::checkpoint_path(uint64_t base_seq, uint64_t end_seq) const {
+    char name[48];
+    std::snprintf(name, sizeof(name), "%020llu-%020llu.idx", (unsigned long long)base_seq, (unsigned long long)end_seq);
+    return (std::filesystem::path(directory_) / name).string();
+}
@@ -0,0 +1,202 @@
+#include "storage/AppendFile.hpp"
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+AppendFile::AppendFile() : handle_(INVALID_HANDLE_VALUE), size_(0) {
+}
+
+bool AppendFile::open(const std::string& path) {
+    close();
+    // Shared read/write/delete so readers can map the file while it grows
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        std::cerr << "[AppendFile] Cannot open " << path << " (error: " << GetLastError() << ")\n";
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    LARGE_INTEGER zero{};
+    if (!GetFileSizeEx(handle, &size) || !SetFilePointerEx(handle, zero, nullptr, FILE_END)) {
+        std::cerr << "[AppendFile] Cannot seek " << path << " (error: " << GetLastError() << ")\n";
+        CloseHandle(handle);
+        return false;
+    }
+    handle_ = handle;
+    size_ = (uint64_t)size.QuadPart;
+    return true;
+}
+
+void AppendFile::close() {
+    if (handle_ != INVALID_HANDLE_VALUE) {
+        CloseHandle((HANDLE)handle_);
+        handle_ = INVALID_HANDLE_VALUE;
+    }
+    size_ = 0;
+}
+
+bool AppendFile::is_open() const {
+    return handle_ != INVALID_HANDLE_VALUE;
+}
+
+bool AppendFile::append(const void* data, size_t size) {
+    const char* bytes = (const char*)data;
+    while (size > 0) {
+        DWORD chunk = (DWORD)(size < 0x40000000 ? size : 0x40000000);
+        DWORD written = 0;
+        if (!WriteFile((HANDLE)handle_, bytes, chunk, &written, nullptr)) {
+            std::cerr << "[AppendFile] Write failed (error: " << GetLastError() << ")\n";
+            return false;
+        }
+        bytes += written;
+        size -= written;
+        size_ += written;
+    }
+    return true;
+}
+
+bool AppendFile::sync() {
+    return FlushFileBuffers((HANDLE)handle_) != 0;
+}
+
+bool AppendFile::truncate(uint64_t size) {
+    LARGE_INTEGER position;
+    position.QuadPart = (LONGLONG)size;
+    if (!SetFilePointerEx((HANDLE)handle_, position, nullptr, FILE_BEGIN) || !SetEndOfFile((HANDLE)handle_)) {
+        std::cerr << "[AppendFile] Truncate failed (error: " << GetLastError() << ")\n";
+        return false;
+    }
+    size_ = size;
+    return true;
+}
+
+#else
+
+AppendFile::AppendFile() : fd_(-1), size_(0) {
+}
+
+bool AppendFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "[AppendFile] Cannot open " << path << " (errno: " << errno << ")\n";
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        std::cerr << "[AppendFile] Cannot stat " << path << " (errno: " << errno << ")\n";
+        ::close(fd);
+        return false;
+    }
+    fd_ = fd;
+    size_ = (uint64_t)info.st_size;
+    return true;
+}
+
+void AppendFile::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+}
+
+bool AppendFile::is_open() const {
+    return fd_ >= 0;
+}
+
+bool AppendFile::append(const void* data, size_t size) {
+    const char* bytes = (const char*)data;
+    while (size > 0) {
+        ssize_t written = ::write(fd_, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[AppendFile] Write failed (errno: " << errno << ")\n";
+            return false;
+        }
+        bytes += written;
+        size -= (size_t)written;
+        size_ += (uint64_t)written;
+    }
+    return true;
+}
+
+bool AppendFile::sync() {
+    return ::fsync(fd_) == 0;
+}
+
+bool AppendFile::truncate(uint64_t size) {
+    if (::ftruncate(fd_, (off_t)size) != 0) {
+        std::cerr << "[AppendFile] Truncate failed (errno: " << errno << ")\n";
+        return false;
+    }
+    size_ = size;
+    return true;
+}
+
+#endif
+
+AppendFile::~AppendFile() {
+    close();
+}
+
+uint64_t AppendFile::size() const {
+    return size_;
+}
+
+// The rename itself is only durable once the directory entry is: MOVEFILE_WRITE_THROUGH on
+// Windows, an fsync of the parent directory elsewhere
+static bool replace_file(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    if (!MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        std::cerr << "[AppendFile] Cannot rename " << from << " (error: " << GetLastError() << ")\n";
+        return false;
+    }
+    return true;
+#else
+    if (::rename(from.c_str(), to.c_str()) != 0) {
+        std::cerr << "[AppendFile] Cannot rename " << from << " (errno: " << errno << ")\n";
+        return false;
+    }
+    std::string directory = std::filesystem::path(to).parent_path().string();
+    if (directory.empty()) directory = ".";
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    const bool synced = fd >= 0 && ::fsync(fd) == 0;
+    if (fd >= 0) ::close(fd);
+    if (!synced) {
+        std::cerr << "[AppendFile] Cannot sync directory " << directory << " (errno: " << errno << ")\n";
+    }
+    return synced;
+#endif
+}
+
+bool write_file_atomically(const std::string& path, const void* data, size_t size) {
+    const std::string temp = path + ".tmp";
+    AppendFile file;
+    bool written = file.open(temp) && file.truncate(0) && file.append(data, size) && file.sync();
+    file.close();
+    if (written && replace_file(temp, path)) return true;
+
+    std::error_code error;
+    std::filesystem::remove(temp, error);
+    return false;
+}
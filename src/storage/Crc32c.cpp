@@ -0,0 +1,214 @@
+#include "storage/Crc32c.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32C_X86 1
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CRC32C_TARGET_SSE42
+#define CRC32C_TARGET_PCLMUL
+#else
+#include <cpuid.h>
+#define CRC32C_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define CRC32C_TARGET_PCLMUL __attribute__((target("sse4.2,pclmul")))
+#endif
+#endif
+
+// Reflected 0x1EDC6F41
+static constexpr uint32_t POLYNOMIAL = 0x82F63B78;
+
+// Slicing-by-8: table[k][b] is the CRC of byte b followed by k zero bytes
+struct Crc32cTables {
+    uint32_t table[8][256];
+
+    Crc32cTables() {
+        for (uint32_t b = 0; b < 256; ++b) {
+            uint32_t crc = b;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (POLYNOMIAL & (0u - (crc & 1)));
+            }
+            table[0][b] = crc;
+        }
+        for (uint32_t b = 0; b < 256; ++b) {
+            for (int k = 1; k < 8; ++k) {
+                table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xFF];
+            }
+        }
+    }
+};
+
+static const Crc32cTables& tables() {
+    static const Crc32cTables instance;
+    return instance;
+}
+
+uint32_t crc32c_portable(const void* data, size_t size, uint32_t crc) {
+    const uint32_t (*table)[256] = tables().table;
+    const unsigned char* bytes = (const unsigned char*)data;
+    crc = ~crc;
+
+    // Eight bytes per step; the word loads assume a little-endian host (x86, ARM)
+    while (size >= 8) {
+        uint32_t low;
+        uint32_t high;
+        std::memcpy(&low, bytes, sizeof(low));
+        std::memcpy(&high, bytes + 4, sizeof(high));
+        low ^= crc;
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^
+              table[4][low >> 24] ^ table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^
+              table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+        bytes += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *bytes++) & 0xFF];
+        --size;
+    }
+    return ~crc;
+}
+
+#ifdef CRC32C_X86
+
+// Polynomials mod P in the reflected representation: bit 31 is x^0, bit 0 is x^31
+static constexpr uint32_t multiply(uint32_t a, uint32_t b) {
+    uint32_t product = 0;
+    for (uint32_t mask = 0x80000000u; mask != 0; mask >>= 1) {
+        if (a & mask) product ^= b;
+        b = (b >> 1) ^ (POLYNOMIAL & (0u - (b & 1)));  // b * x
+    }
+    return product;
+}
+
+static constexpr uint32_t x_power(uint64_t n) {
+    uint32_t result = 0x80000000u;  // x^0
+    uint32_t square = 0x40000000u;  // x^1
+    for (; n != 0; n >>= 1) {
+        if (n & 1) result = multiply(result, square);
+        square = multiply(square, square);
+    }
+    return result;
+}
+
+// Three streams of this many bytes each are checksummed side by side, hiding the crc32
+// instruction's 3-cycle latency; short blocks pick up buffers too small for long ones
+static constexpr size_t LONG_BLOCK = 8192;
+static constexpr size_t SHORT_BLOCK = 256;
+
+// Appending n zero bytes multiplies the CRC register by x^(8n). crc32 over the 64-bit
+// carry-less product c * k yields c * k * x^33, so shifting by n bytes uses k = x^(8n - 33).
+static constexpr uint32_t LONG_SHIFT_1 = x_power(8 * LONG_BLOCK - 33);
+static constexpr uint32_t LONG_SHIFT_2 = x_power(16 * LONG_BLOCK - 33);
+static constexpr uint32_t SHORT_SHIFT_1 = x_power(8 * SHORT_BLOCK - 33);
+static constexpr uint32_t SHORT_SHIFT_2 = x_power(16 * SHORT_BLOCK - 33);
+
+// Plain crc32 instructions, eight bytes at a time; works on the raw (uncomplemented) register
+CRC32C_TARGET_SSE42 static uint64_t crc32c_serial(const unsigned char*& bytes, size_t& size, uint64_t crc) {
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        crc = _mm_crc32_u64(crc, word);
+        bytes += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        crc = _mm_crc32_u8((uint32_t)crc, *bytes++);
+        --size;
+    }
+    return crc;
+}
+
+CRC32C_TARGET_PCLMUL static uint64_t shift_crc(uint64_t crc, uint32_t constant) {
+    const __m128i product = _mm_clmulepi64_si128(_mm_cvtsi32_si128((int)(uint32_t)crc),
+                                                 _mm_cvtsi32_si128((int)constant), 0);
+    return _mm_crc32_u64(0, (uint64_t)_mm_cvtsi128_si64(product));
+}
+
+// Consumes 3 * block bytes: stream 0 continues `crc`, streams 1 and 2 start from zero,
+// and the three are joined by shifting the first two past the bytes that follow them
+CRC32C_TARGET_PCLMUL static uint64_t crc32c_three_way(const unsigned char* bytes, size_t block, uint64_t crc,
+                                                      uint32_t shift_1, uint32_t shift_2) {
+    uint64_t crc_1 = 0;
+    uint64_t crc_2 = 0;
+    const unsigned char* end = bytes + block;
+    while (bytes < end) {
+        uint64_t word_0;
+        uint64_t word_1;
+        uint64_t word_2;
+        std::memcpy(&word_0, bytes, sizeof(word_0));
+        std::memcpy(&word_1, bytes + block, sizeof(word_1));
+        std::memcpy(&word_2, bytes + 2 * block, sizeof(word_2));
+        crc = _mm_crc32_u64(crc, word_0);
+        crc_1 = _mm_crc32_u64(crc_1, word_1);
+        crc_2 = _mm_crc32_u64(crc_2, word_2);
+        bytes += 8;
+    }
+    return shift_crc(crc, shift_2) ^ shift_crc(crc_1, shift_1) ^ crc_2;
+}
+
+CRC32C_TARGET_SSE42 static uint32_t crc32c_sse42(const void* data, size_t size, uint32_t crc) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    return ~(uint32_t)crc32c_serial(bytes, size, ~crc);
+}
+
+CRC32C_TARGET_PCLMUL static uint32_t crc32c_pclmul(const void* data, size_t size, uint32_t crc) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t state = ~crc;
+    while (size >= 3 * LONG_BLOCK) {
+        state = crc32c_three_way(bytes, LONG_BLOCK, state, LONG_SHIFT_1, LONG_SHIFT_2);
+        bytes += 3 * LONG_BLOCK;
+        size -= 3 * LONG_BLOCK;
+    }
+    while (size >= 3 * SHORT_BLOCK) {
+        state = crc32c_three_way(bytes, SHORT_BLOCK, state, SHORT_SHIFT_1, SHORT_SHIFT_2);
+        bytes += 3 * SHORT_BLOCK;
+        size -= 3 * SHORT_BLOCK;
+    }
+    return ~(uint32_t)crc32c_serial(bytes, size, state);
+}
+
+#endif
+
+using Crc32cFunction = uint32_t (*)(const void* data, size_t size, uint32_t crc);
+
+struct Crc32cDispatch {
+    Crc32cFunction function;
+    const char* name;
+
+    Crc32cDispatch() : function(crc32c_portable), name("portable") {
+#ifdef CRC32C_X86
+        unsigned int features = 0;
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        features = (unsigned int)info[2];
+#else
+        unsigned int eax, ebx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &features, &edx)) features = 0;
+#endif
+        const bool sse42 = (features & (1u << 20)) != 0;
+        const bool pclmul = (features & (1u << 1)) != 0;
+        if (sse42 && pclmul) {
+            function = crc32c_pclmul;
+            name = "sse4.2+pclmul";
+        } else if (sse42) {
+            function = crc32c_sse42;
+            name = "sse4.2";
+        }
+#endif
+    }
+};
+
+static const Crc32cDispatch& dispatch() {
+    static const Crc32cDispatch instance;
+    return instance;
+}
+
+uint32_t crc32c(const void* data, size_t size, uint32_t crc) {
+    return dispatch().function(data, size, crc);
+}
+
+const char* crc32c_implementation() {
+    return dispatch().name;
+}
@@ -0,0 +1,118 @@
+#include "storage/LzBlock.hpp"
+#include <cstring>
+#include <vector>
+
+static constexpr int HASH_BITS = 16;
+// Inputs shorter than this are stored as literals; matches never start in the last few
+// bytes, so the search can always read a whole 32-bit word
+static constexpr size_t MIN_INPUT = 16;
+static constexpr size_t LAST_LITERALS = 5;
+
+static uint32_t load32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hash32(uint32_t value) {
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// A length beyond a token nibble: 15 in the nibble, then 255s and a final byte below 255
+static void put_length(std::string& out, size_t length) {
+    for (; length >= 255; length -= 255) out.push_back((char)255);
+    out.push_back((char)length);
+}
+
+static void put_sequence(std::string& out, const unsigned char* literals, size_t literal_count, size_t offset,
+                         size_t match_length) {
+    const size_t match_code = match_length > 0 ? match_length - LZ_MIN_MATCH : 0;
+    const unsigned char token = (unsigned char)(((literal_count < 15 ? literal_count : 15) << 4) |
+                                                (match_code < 15 ? match_code : 15));
+    out.push_back((char)token);
+    if (literal_count >= 15) put_length(out, literal_count - 15);
+    out.append(reinterpret_cast<const char*>(literals), literal_count);
+    if (match_length == 0) return;
+    out.push_back((char)(offset & 0xFF));
+    out.push_back((char)(offset >> 8));
+    if (match_code >= 15) put_length(out, match_code - 15);
+}
+
+void lz_compress(const void* data, size_t size, std::string& out) {
+    const unsigned char* input = (const unsigned char*)data;
+    size_t anchor = 0;  // first byte not yet emitted
+    if (size >= MIN_INPUT) {
+        // Most recent position of each hashed 4-byte prefix, plus one (0 = none)
+        std::vector<uint32_t> table((size_t)1 << HASH_BITS, 0);
+        const size_t match_limit = size - LAST_LITERALS;
+        size_t pos = 0;
+        while (pos + LZ_MIN_MATCH <= match_limit) {
+            const uint32_t word = load32(input + pos);
+            uint32_t& slot = table[hash32(word)];
+            const size_t candidate = slot;
+            slot = (uint32_t)(pos + 1);
+            if (candidate == 0 || pos - (candidate - 1) > LZ_MAX_OFFSET || load32(input + candidate - 1) != word) {
+                // Incompressible stretches are skipped through faster the longer they get
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+
+            const size_t match = candidate - 1;
+            size_t length = LZ_MIN_MATCH;
+            while (pos + length < match_limit && input[match + length] == input[pos + length]) ++length;
+            put_sequence(out, input + anchor, pos - anchor, pos - match, length);
+            pos += length;
+            anchor = pos;
+        }
+    }
+    put_sequence(out, input + anchor, size - anchor, 0, 0);
+}
+
+// Reads a length continued past a full nibble; false if the input runs out
+static bool get_length(const unsigned char*& pos, const unsigned char* end, size_t& length) {
+    for (;;) {
+        if (pos == end) return false;
+        const unsigned char byte = *pos++;
+        length += byte;
+        if (byte != 255) return true;
+    }
+}
+
+bool lz_decompress(const void* data, size_t size, size_t decompressed_size, std::string& out) {
+    const unsigned char* pos = (const unsigned char*)data;
+    const unsigned char* end = pos + size;
+    const size_t base = out.size();
+    out.resize(base + decompressed_size);
+    char* output = &out[0] + base;
+    size_t produced = 0;
+
+    while (pos < end) {
+        const unsigned char token = *pos++;
+        size_t literal_count = token >> 4;
+        if (literal_count == 15 && !get_length(pos, end, literal_count)) return false;
+        if (literal_count > (size_t)(end - pos) || literal_count > decompressed_size - produced) return false;
+        std::memcpy(output + produced, pos, literal_count);
+        pos += literal_count;
+        produced += literal_count;
+        if (pos == end) break;  // the last sequence has no match
+
+        if (end - pos < 2) return false;
+        const size_t offset = (size_t)pos[0] | ((size_t)pos[1] << 8);
+        pos += 2;
+        size_t length = token & 0x0F;
+        if (length == 15 && !get_length(pos, end, length)) return false;
+        length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > produced || length > decompressed_size - produced) return false;
+
+        // A match closer than its length repeats bytes it is producing, so it goes byte by byte
+        const char* from = output + produced - offset;
+        char* to = output + produced;
+        if (offset >= length) {
+            std::memcpy(to, from, length);
+        } else {
+            for (size_t i = 0; i < length; ++i) to[i] = from[i];
+        }
+        produced += length;
+    }
+    return produced == decompressed_size;
+}
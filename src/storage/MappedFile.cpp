@@ -0,0 +1,171 @@
+#include "storage/MappedFile.hpp"
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+    : file_(INVALID_HANDLE_VALUE), mapping_(nullptr), data_(nullptr), size_(0) {
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "[MappedFile] Cannot open " << path << " (error: " << GetLastError() << ")\n";
+        return false;
+    }
+    file_ = file;
+    path_ = path;
+    if (!map()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close() {
+    unmap();
+    if (file_ != INVALID_HANDLE_VALUE) {
+        CloseHandle((HANDLE)file_);
+        file_ = INVALID_HANDLE_VALUE;
+    }
+    path_.clear();
+}
+
+bool MappedFile::is_open() const {
+    return file_ != INVALID_HANDLE_VALUE;
+}
+
+bool MappedFile::map() {
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx((HANDLE)file_, &size)) {
+        std::cerr << "[MappedFile] Cannot size " << path_ << " (error: " << GetLastError() << ")\n";
+        return false;
+    }
+    if (size.QuadPart == 0) return true;  // empty files cannot be mapped on Windows
+
+    HANDLE mapping = CreateFileMappingA((HANDLE)file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        std::cerr << "[MappedFile] CreateFileMapping failed for " << path_ << " (error: " << GetLastError() << ")\n";
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        std::cerr << "[MappedFile] MapViewOfFile failed for " << path_ << " (error: " << GetLastError() << ")\n";
+        CloseHandle(mapping);
+        return false;
+    }
+    mapping_ = mapping;
+    data_ = (const char*)view;
+    size_ = (size_t)size.QuadPart;
+    return true;
+}
+
+void MappedFile::unmap() {
+    if (data_) {
+        UnmapViewOfFile(data_);
+        data_ = nullptr;
+    }
+    if (mapping_) {
+        CloseHandle((HANDLE)mapping_);
+        mapping_ = nullptr;
+    }
+    size_ = 0;
+}
+
+#else
+
+MappedFile::MappedFile() : fd_(-1), data_(nullptr), size_(0) {
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "[MappedFile] Cannot open " << path << " (errno: " << errno << ")\n";
+        return false;
+    }
+    fd_ = fd;
+    path_ = path;
+    if (!map()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close() {
+    unmap();
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    path_.clear();
+}
+
+bool MappedFile::is_open() const {
+    return fd_ >= 0;
+}
+
+bool MappedFile::map() {
+    struct stat info;
+    if (fstat(fd_, &info) != 0) {
+        std::cerr << "[MappedFile] Cannot stat " << path_ << " (errno: " << errno << ")\n";
+        return false;
+    }
+    if (info.st_size == 0) return true;
+
+    void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd_, 0);
+    if (view == MAP_FAILED) {
+        std::cerr << "[MappedFile] mmap failed for " << path_ << " (errno: " << errno << ")\n";
+        return false;
+    }
+    data_ = (const char*)view;
+    size_ = (size_t)info.st_size;
+    return true;
+}
+
+void MappedFile::unmap() {
+    if (data_) {
+        munmap((void*)data_, size_);
+        data_ = nullptr;
+    }
+    size_ = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::remap() {
+    if (!is_open()) return false;
+    unmap();
+    return map();
+}
+
+const char* MappedFile::data() const {
+    return data_;
+}
+
+size_t MappedFile::size() const {
+    return size_;
+}
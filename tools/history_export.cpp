@@ -0,0 +1,73 @@
+// history_export.cpp - converts the server's room history into a column file for analytics
+//
+// Reads each room's MessageLog directory read-only (safe next to a running server; records
+// still being appended are left for the next export) and writes one column file covering all
+// rooms. Erased messages are left out.
+//
+// Usage: history_export <history_dir> <output.chatcol> [rooms...]
+//        history_export history history-2026.chatcol lobby dev
+#include "analytics/ColumnFile.hpp"
+#include "server/MessageLog.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::fprintf(stderr, "Usage: %s <history_dir> <output.chatcol> [rooms...]\n", argv[0]);
+        return 2;
+    }
+    namespace fs = std::filesystem;
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::string> rooms(argv + 3, argv + argc);
+    if (rooms.empty()) {
+        std::error_code error;
+        for (const auto& item : fs::directory_iterator(argv[1], error)) {
+            if (item.is_directory(error)) rooms.push_back(item.path().filename().string());
+        }
+        if (error) {
+            std::fprintf(stderr, "Cannot list %s: %s\n", argv[1], error.message().c_str());
+            return 1;
+        }
+        std::sort(rooms.begin(), rooms.end());
+    }
+
+    ColumnFileWriter writer;
+    if (!writer.open(argv[2])) return 1;
+
+    uint64_t rows = 0;
+    uint64_t erased = 0;
+    uint64_t text_bytes = 0;
+    for (const std::string& room : rooms) {
+        uint64_t room_rows = 0;
+        const bool complete = MessageLog::scan((fs::path(argv[1]) / room).string(), [&](const MessageLog::Entry& entry) {
+            if (entry.deleted) {
+                ++erased;
+                return true;
+            }
+            ++room_rows;
+            text_bytes += entry.sender.size() + entry.text.size();
+            return writer.add(room, entry.seq, entry.timestamp_ms, entry.sender, entry.text);
+        });
+        if (!complete) {
+            std::fprintf(stderr, "Export of room %s failed\n", room.c_str());
+            return 1;
+        }
+        std::printf("%-24s %12llu messages\n", room.c_str(), (unsigned long long)room_rows);
+        rows += room_rows;
+    }
+    if (!writer.close()) return 1;
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::error_code error;
+    const uint64_t file_bytes = fs::file_size(argv[2], error);
+    std::printf("%llu messages (%llu erased ones left out), %.1f MB of senders and text -> %.1f MB "
+                "(%.2fx) in %.2f s\n",
+                (unsigned long long)rows, (unsigned long long)erased, text_bytes / 1e6, file_bytes / 1e6,
+                file_bytes ? (double)text_bytes / file_bytes : 0.0, seconds);
+    return 0;
+}
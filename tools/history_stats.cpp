@@ -0,0 +1,175 @@
+// history_stats.cpp - example reader for column files written by history_export
+//
+// Reports message counts per room, the busiest senders and the volume per month. Row groups
+// outside --from/--to are skipped from the footer alone, and the text column is only decoded
+// when --contains needs it, so a scan normally touches a few bytes per message.
+//
+// Usage: history_stats <file.chatcol> [--from YYYY-MM-DD] [--to YYYY-MM-DD] [--contains word]
+//                      [--top N]
+//        history_stats history-2026.chatcol --from 2026-01-01 --contains deploy
+#include "analytics/ColumnFile.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+constexpr int64_t MS_PER_DAY = 86400000;
+
+// Days since 1970-01-01 of a proleptic Gregorian date (H. Hinnant's days_from_civil)
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+// "YYYY-MM" of a UTC timestamp (civil_from_days)
+static std::string month_of(int64_t timestamp_ms) {
+    int64_t z = (timestamp_ms >= 0 ? timestamp_ms : timestamp_ms - (MS_PER_DAY - 1)) / MS_PER_DAY + 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = (unsigned)(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+    const int64_t y = (int64_t)yoe + era * 400 + (m <= 2);
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%04lld-%02u", (long long)y, m);
+    return buffer;
+}
+
+// Start of a UTC day given as YYYY-MM-DD; false if malformed
+static bool parse_date(const char* text, int64_t& timestamp_ms) {
+    int y;
+    unsigned m;
+    unsigned d;
+    if (std::sscanf(text, "%d-%u-%u", &y, &m, &d) != 3 || m < 1 || m > 12 || d < 1 || d > 31) return false;
+    timestamp_ms = days_from_civil(y, m, d) * MS_PER_DAY;
+    return true;
+}
+
+struct Totals {
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+};
+
+static void print_top(const char* title, std::vector<std::pair<std::string, Totals>> rows, size_t top) {
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+        return a.second.messages != b.second.messages ? a.second.messages > b.second.messages : a.first < b.first;
+    });
+    if (rows.size() > top) rows.resize(top);
+    std::printf("\n%-24s %12s %14s\n", title, "messages", "text bytes");
+    for (const auto& row : rows) {
+        std::printf("%-24s %12llu %14llu\n", row.first.c_str(), (unsigned long long)row.second.messages,
+                    (unsigned long long)row.second.bytes);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <file.chatcol> [--from YYYY-MM-DD] [--to YYYY-MM-DD] [--contains word] "
+                             "[--top N]\n", argv[0]);
+        return 2;
+    }
+    int64_t from_ms = INT64_MIN;
+    int64_t to_ms = INT64_MAX;  // exclusive
+    std::string contains;
+    size_t top = 10;
+    for (int i = 2; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (has_value && std::strcmp(argv[i], "--from") == 0 && parse_date(argv[i + 1], from_ms)) {
+            ++i;
+        } else if (has_value && std::strcmp(argv[i], "--to") == 0 && parse_date(argv[i + 1], to_ms)) {
+            to_ms += MS_PER_DAY;  // the whole day
+            ++i;
+        } else if (has_value && std::strcmp(argv[i], "--contains") == 0) {
+            contains = argv[++i];
+        } else if (has_value && std::strcmp(argv[i], "--top") == 0) {
+            top = (size_t)std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            std::fprintf(stderr, "Bad argument: %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    ColumnFileReader reader;
+    if (!reader.open(argv[1])) return 1;
+
+    const unsigned columns = COLUMN_TIME | COLUMN_SENDER | COLUMN_LENGTH | (contains.empty() ? 0u : (unsigned)COLUMN_TEXT);
+    std::vector<Totals> per_room(reader.rooms().size());
+    std::vector<Totals> per_sender(reader.senders().size());
+    std::map<std::string, Totals> per_month;
+    Totals total;
+    uint64_t scanned = 0;
+    size_t skipped_groups = 0;
+    Totals* month = nullptr;
+    int64_t month_day = 0;
+    ColumnBatch batch;
+    for (size_t g = 0; g < reader.groups().size(); ++g) {
+        const ColumnGroup& group = reader.groups()[g];
+        if (group.max_ms < from_ms || group.min_ms >= to_ms) {
+            ++skipped_groups;
+            continue;
+        }
+        if (!reader.read(g, columns, batch)) return 1;
+        scanned += group.rows;
+
+        size_t text_offset = 0;
+        for (size_t row = 0; row < group.rows; ++row) {
+            const int64_t timestamp_ms = batch.timestamp_ms[row];
+            const uint32_t length = batch.length[row];
+            bool match = timestamp_ms >= from_ms && timestamp_ms < to_ms;
+            if (match && !contains.empty()) {
+                const std::string_view text(batch.text.data() + text_offset, length);
+                match = text.find(contains) != std::string_view::npos;
+            }
+            text_offset += length;
+            if (!match) continue;
+
+            for (Totals* totals : {&total, &per_room[group.room], &per_sender[batch.sender[row]]}) {
+                ++totals->messages;
+                totals->bytes += length;
+            }
+            // Rows of a group are in time order, so the month is only looked up when the day changes
+            const int64_t day = timestamp_ms / MS_PER_DAY - (timestamp_ms % MS_PER_DAY < 0);
+            if (day != month_day || !month) {
+                month = &per_month[month_of(timestamp_ms)];
+                month_day = day;
+            }
+            ++month->messages;
+            month->bytes += length;
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<std::pair<std::string, Totals>> rooms;
+    for (size_t i = 0; i < per_room.size(); ++i) {
+        if (per_room[i].messages) rooms.emplace_back(reader.rooms()[i], per_room[i]);
+    }
+    std::vector<std::pair<std::string, Totals>> senders;
+    for (size_t i = 0; i < per_sender.size(); ++i) {
+        if (per_sender[i].messages) senders.emplace_back(reader.senders()[i], per_sender[i]);
+    }
+    print_top("room", std::move(rooms), SIZE_MAX);
+    print_top("sender", std::move(senders), top);
+    std::printf("\n%-24s %12s %14s\n", "month", "messages", "text bytes");
+    for (const auto& entry : per_month) {
+        std::printf("%-24s %12llu %14llu\n", entry.first.c_str(), (unsigned long long)entry.second.messages,
+                    (unsigned long long)entry.second.bytes);
+    }
+
+    std::printf("\n%llu of %llu messages matched, %llu text bytes; scanned %llu rows (%zu of %zu row groups "
+                "skipped) in %.3f s, %.1f M rows/s\n",
+                (unsigned long long)total.messages, (unsigned long long)reader.row_count(),
+                (unsigned long long)total.bytes, (unsigned long long)scanned, skipped_groups,
+                reader.groups().size(), seconds, seconds > 0 ? scanned / seconds / 1e6 : 0.0);
+    return 0;
+}